@@ -0,0 +1,49 @@
+#include "AlignedBuffer.h"
+
+#include <cstdint>
+#include <memory>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+    const size_t HUGE_PAGE = 2 << 20;
+}
+
+AlignedBuffer::AlignedBuffer(size_t bytes, bool hugePages) : bytes(bytes)
+{
+#ifdef __linux__
+    // Mappings are only aligned to regular pages, an extra huge page is mapped so the buffer can start on a huge page boundary.
+    // Rounding its length up to whole huge pages then lets all of it be backed by them.
+    if(hugePages && bytes >= HUGE_PAGE) {
+        size_t length = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        void * memory = mmap(nullptr, length + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory != MAP_FAILED) {
+            allocation = memory;
+            allocated = length + HUGE_PAGE;
+            aligned = reinterpret_cast<void *>((reinterpret_cast<uintptr_t>(memory) + HUGE_PAGE - 1) & ~(uintptr_t) (HUGE_PAGE - 1));
+            madvise(aligned, length, MADV_HUGEPAGE);
+            mapped = true;
+            return;
+        }
+    }
+#endif
+
+    allocated = bytes + CACHE_LINE;
+    allocation = new char[allocated];
+    aligned = allocation;
+    size_t space = allocated;
+    std::align(CACHE_LINE, bytes, aligned, space);
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+#ifdef __linux__
+    if(mapped) {
+        munmap(allocation, allocated);
+        return;
+    }
+#endif
+    delete[] static_cast<char *>(allocation);
+}
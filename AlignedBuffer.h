@@ -0,0 +1,33 @@
+#ifndef ALIGNEDBUFFER_H
+#define ALIGNEDBUFFER_H
+
+#include <cstddef>
+
+/// Uninitialized memory aligned to a cache line, freed when the buffer is destroyed.
+/// Large buffers may ask to be backed by huge pages (Linux only), which saves TLB misses when they're accessed randomly;
+/// when huge pages aren't available regular pages are used instead.
+class AlignedBuffer {
+public:
+    static const size_t CACHE_LINE = 64;
+
+    explicit AlignedBuffer(size_t bytes, bool hugePages = false);
+    ~AlignedBuffer();
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer & operator=(const AlignedBuffer &) = delete;
+
+    void * data() const { return aligned; }
+    size_t size() const { return bytes; }
+
+    /// Whether the buffer was mapped with a request for huge pages, the kernel decides whether they're actually used
+    bool hugePages() const { return mapped; }
+
+private:
+    void * allocation = nullptr;    // What has to be freed, 'aligned' lies within it
+    void * aligned = nullptr;
+    size_t bytes;
+    size_t allocated = 0;
+    bool mapped = false;            // Allocated with mmap instead of new
+};
+
+#endif
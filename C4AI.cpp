@@ -1,51 +1,147 @@
 #include "C4AI.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "TreeSearch.h"
+#include "ThreadPool.h"
 #include "C4Abstract.h"
+#include "C4BitBoard.h"
+#include "C4BatchEvaluator.h"
+#include "C4PatternEvaluator.h"
 
-Move C4AI::FindBestMove(const Match & match)
+namespace {
+    /// Bitboard of a child of the state 'parent' was converted from, derived from the move that leads to it:
+    /// the child has a disc in the lowest empty slot of exactly one column. Anything else is converted as usual.
+    BitBoard deriveChild(const BitBoard & parent, const State & child)
+    {
+        uint64_t playable = (parent.mask + C4BitBoard::BOTTOM) & C4BitBoard::BOARD;
+        for(int col = 0; col < C4BitBoard::WIDTH; col++) {
+            uint64_t slot = playable & C4BitBoard::columnMask(col);
+            if(!slot) continue;
+            int row = C4BitBoard::HEIGHT - 1 - (__builtin_ctzll(slot) - col * C4BitBoard::STRIDE);
+            if(child[row][col] != Player::None) return doMove(parent, col);
+        }
+        return toBitBoard(child);
+    }
+}
+
+Move C4AI::FindBestMove(Match & match, const SearchResources & resources)
 {
+    std::ostream & log = *resources.log;
     Move bestMove = -1;
 
     // Find all moves and rate them
     Player me = getCurrentPlayer(match.board);
     std::vector<Move> moves = getMoves(match.board);
 
+    // The previous search is only of use to this turn, forget it before returning early on any path
+    const SearchMemory previous = match.previousSearch;
+    match.previousSearch.valid = false;
+
     // Edge cases...
-    if(moves.empty()) std::cerr << "ERROR: Board appears to be full, yet AI is asked to pick a move!" << std::endl;
+    if(moves.empty()) log << "ERROR: Board appears to be full, yet AI is asked to pick a move!" << std::endl;
     if(moves.size() == 1) return moves[0]; // Might occur later in matches
 
-    // Rate all moves, safe their scores
-    int moveRatings [moves.size()];
+    // Continue where the previous turn left off if the opponent replied as expected: the table still holds
+    // the results of that search, so the depth it reached can be searched again at little cost.
     int searchDepth = INITIAL_SEARCH_DEPTH;
+    Move hint = -1;
+    if(previous.valid && previous.line.size() > 2 && resources.table) {
+        if(doMove(doMove(previous.root, previous.line[0]), previous.line[1]) == match.board) {
+            hint = previous.line[2];
+            searchDepth = std::max(INITIAL_SEARCH_DEPTH, previous.depth - 2);
+            size_t played = std::find(previous.moves.begin(), previous.moves.end(), previous.line[0]) - previous.moves.begin();
+            log << "Opponent played the expected move " << previous.line[1] << " (expected rating: "
+                << (played < previous.ratings.size() ? previous.ratings[played] : 0) << "), resuming search at depth " << searchDepth << "." << std::endl;
+        } else log << "Opponent left the expected line, starting a new search." << std::endl;
+    }
+
+    // The move the previous search expected to play is searched first
+    auto hinted = std::find(moves.begin(), moves.end(), hint);
+    if(hinted != moves.end()) std::rotate(moves.begin(), hinted, hinted + 1);
+
+    // Rate all moves, safe their scores
+    std::vector<int> moveRatings(moves.size());
+    int finishedDepth = 0;
+    int pass = 1;
 
     do {
-        if(searchDepth > INITIAL_SEARCH_DEPTH) std::cerr << "Enough time left to do another pass with depth: " << searchDepth << "." << std::endl;
-        std::cerr << "Starting pass #" << searchDepth - INITIAL_SEARCH_DEPTH + 1 << " with a search depth of " << searchDepth << "." << std::endl;
+        if(pass > 1) log << "Enough time left to do another pass with depth: " << searchDepth << "." << std::endl;
+        log << "Starting pass #" << pass << " with a search depth of " << searchDepth << "." << std::endl;
 
         bool searchTreeExhausted = true;
 
+        // Every move gets its own context so they can be searched concurrently, the first pass is never aborted
+        // as there would be no ratings to fall back on, unless it continues the previous search which suggested a move.
+        std::vector<int> passRatings(moves.size());
+        std::vector<char> fullMoveTreeEvaluated(moves.size(), true);
+        std::vector<SearchContext<State>> contexts(moves.size());
+        for(SearchContext<State> & context : contexts) {
+            context.table = resources.table;
+            context.hash = HashState;
+            context.hasDeadline = pass > 1 || hint != -1;
+            context.deadline = match.turnDeadline();
+            context.selectivity = resources.selectivity;
+            context.findForcing = FindForcingMoves;
+            context.evaluateChildren = EvaluateChildStates;
+        }
+
+        auto rateMove = [&](size_t i) {
+            bool fullTreeEvaluated = true;
+            passRatings[i] = RateMove(match.board, moves[i], searchDepth, contexts[i], &fullTreeEvaluated);
+            fullMoveTreeEvaluated[i] = fullTreeEvaluated;
+        };
+
+        if(resources.pool) {
+            // Only this turns' root moves are helped with while waiting, never those of another match
+            ThreadPool::Group group;
+            for(size_t i = 0; i < moves.size(); i++)
+                resources.pool->spawn(group, [&, i]() { rateMove(i); });
+            resources.pool->wait(group);
+        } else {
+            for(size_t i = 0; i < moves.size(); i++) {
+                rateMove(i);
+                if(passRatings[i] == Score::Guaranteed_Win && !contexts[i].aborted) break;
+            }
+        }
+
+        SearchContext<State> statistics;
+        bool passAborted = false;
+        for(const SearchContext<State> & context : contexts) {
+            statistics.addStatistics(context);
+            if(context.aborted) passAborted = true;
+        }
+        if(passAborted && pass == 1) {
+            log << "Pass #1 could not be finished before the deadline, playing the move the previous search expected." << std::endl;
+            return hint;
+        }
+        if(passAborted) {
+            log << "Pass #" << pass << " could not be finished before the deadline, using results of the previous pass." << std::endl;
+            break;
+        }
+        moveRatings = passRatings;
+        finishedDepth = searchDepth;
+
         for (int i = 0; i < moves.size(); i++) {
-            bool fullMoveTreeEvaluated = true;
-            State child = doMove(match.board, moves[i]);
-            moveRatings[i] = TreeSearch::MiniMaxAB(child, EvaluateState, GetChildStates, searchDepth, false, me, Score::Should_Lose, Score::Guaranteed_Win, &fullMoveTreeEvaluated);
             if(moveRatings[i] == Score::Guaranteed_Win) {
-                std::cerr << "Found a route to a guaranteed win... Breaking off search!" << std::endl;
+                log << "Found a route to a guaranteed win... Breaking off search!" << std::endl;
                 return moves[i];
             }
-            if(!fullMoveTreeEvaluated) searchTreeExhausted = false;
-            else std::cerr << "Exhausted search tree of move #" << i << "." << std::endl;
+            if(!fullMoveTreeEvaluated[i]) searchTreeExhausted = false;
+            else log << "Exhausted search tree of move #" << i << "." << std::endl;
         }
-        std::cerr << "Finished pass #" << searchDepth - INITIAL_SEARCH_DEPTH + 1 << "." << std::endl;
-        std::cerr << "Time elapsed: " << match.timeElapsedThisTurn() << "/" << match.time_per_move << " ms." << std::endl;
+        log << "Finished pass #" << pass << " (" << statistics.nodes << " nodes, "
+            << statistics.reductions << " reductions, " << statistics.researches << " re-searches, "
+            << statistics.extensions << " extensions)." << std::endl;
+        log << "Time elapsed: " << match.timeElapsedThisTurn() << "/" << match.time_per_move << " ms." << std::endl;
         if(searchTreeExhausted)
         {
-            std::cerr << "Entire search tree was exhausted! Bot knows how this game will end if played perfectly by both sides." << std::endl;
+            log << "Entire search tree was exhausted! Bot knows how this game will end if played perfectly by both sides." << std::endl;
             break;
-        } else std::cerr << "MiniMax did not find definite outcome for a perfectly played match..." << std::endl;
+        } else log << "MiniMax did not find definite outcome for a perfectly played match..." << std::endl;
         searchDepth++; // Increase search depth for next iteration.
+        pass++;
     }
     while ( // Keep searching 1 level deeper if there's enough time left, do not risk loosing time-bank time during first 2 rounds, its not worth it
             (match.timeElapsedThisTurn() * 3 < match.time_per_move && match.timebank > (5 * match.time_per_move) && match.round > 2)
@@ -59,7 +155,7 @@ Move C4AI::FindBestMove(const Match & match)
         if (moveRatings[i] > highestRating) highestRating = moveRatings[i];
 
     if(highestRating == Score::Should_Lose)
-        std::cerr << "All examined moves result in a loss! Chances are i will lose." << std::endl;
+        log << "All examined moves result in a loss! Chances are i will lose." << std::endl;
 
     // There might be multiple moves with the same -best score, put all of them in a list
     std::vector<Move> bestMoves;
@@ -67,36 +163,58 @@ Move C4AI::FindBestMove(const Match & match)
         if(moveRatings[i] == highestRating)
             bestMoves.push_back(moves[i]);
 
-    if(bestMoves.empty()) std::cerr << "ERROR: Best moves list is empty!" << std::endl;
+    if(bestMoves.empty()) log << "ERROR: Best moves list is empty!" << std::endl;
     else if(bestMoves.size() == 1) bestMove = bestMoves[0];
     else {
         bool fullMoveTreeEvaluated = true;
-        std::cerr << "Moves yielding equal results have been found, picking one using secondary heuristics: " << std::endl;
+        log << "Moves yielding equal results have been found, picking one using secondary heuristics: " << std::endl;
         int highest = -1000;
         auto startPass2 = match.timeElapsedThisTurn();
         for (Move m : bestMoves) {
             State moveResult = doMove(match.board, m);
             int score = TreeSearch::MiniMaxAB(moveResult, RateSecondaryHeuristic, GetChildStates, 3, false, me, Score::Min, Score::Max, &fullMoveTreeEvaluated);
-            std::cerr << "  - Move " << m << " yields a heuristic score of: " << score << "." << std::endl;
+            log << "  - Move " << m << " yields a heuristic score of: " << score << "." << std::endl;
             if (score > highest || bestMove == -1) {
                 highest = score;
                 bestMove = m;
             }
         }
         auto pass2Time = match.timeElapsedThisTurn() - startPass2;
-        std::cerr << "Finished second pass in " << pass2Time << " ms." << std::endl;
+        log << "Finished second pass in " << pass2Time << " ms." << std::endl;
+
+    }
+    if(bestMove == -1) log << "ERROR: Best move not found!" << std::endl;
+    else {
+        // Remember the line this search expects, the next turn may continue it
+        SearchMemory & memory = match.previousSearch;
+        memory.valid = true;
+        memory.root = match.board;
+        memory.depth = finishedDepth;
+        memory.moves = moves;
+        memory.ratings = moveRatings;
+        memory.line.assign(1, bestMove);
 
+        SearchContext<State> context;
+        context.table = resources.table;
+        context.hash = HashState;
+        State node = doMove(match.board, bestMove);
+        for(const State & next : TreeSearch::PrincipalVariation(node, GetChildStates, me, context, finishedDepth)) {
+            // The only column that grew is the move played
+            uint64_t added = toBitBoard(next).mask ^ toBitBoard(node).mask;
+            memory.line.push_back((Move) (__builtin_ctzll(added) / C4BitBoard::STRIDE));
+            node = next;
+        }
+        log << "Expected line:";
+        for(Move m : memory.line) log << " " << m;
+        log << std::endl;
     }
-    if(bestMove == -1) std::cerr << "ERROR: Best move not found!" << std::endl;
     return bestMove; // Return highest-rating move
 }
 
 int C4AI::EvaluateState(const State & state, const Player & positive)
 {
-    Player winner = getWinner(state);                                       // Is there a winner?
-    if(winner == positive) return Score::Guaranteed_Win;                    // Bot has won in evaluated state
-    if(winner == Player::None) return RatePrimaryHeuristic(state, positive);// No winner, rate state with heuristics
-    return Score::Should_Lose;                                              // Opponent has won in evaluated state
+    // Wins, losses, draws and 'RatePrimaryHeuristic' are all found in one pass over the pattern table
+    return C4PatternEvaluator::Evaluate(state, positive);
 }
 
 int C4AI::RateFinishedGame(const State & state, const Player & positive)
@@ -107,24 +225,92 @@ int C4AI::RateFinishedGame(const State & state, const Player & positive)
     return Score::Should_Lose;
 }
 
+uint64_t C4AI::HashState(const State & state, const Player & positive)
+{
+    return getKey(toBitBoard(state)) | (positive == Player::O ? 1ULL << 63 : 0);
+}
+
+int C4AI::RateMove(const State & state, const Move & move, int depth, SearchContext<State> & context, bool * isFullTreeEvaluated)
+{
+    // Searches on the same thread share a stack, unless one is already using it further up the call stack
+    thread_local SearchStack<State> threadStack;
+    bool useThreadStack = !context.stack && !threadStack.depth();
+    if(useThreadStack) {
+        context.stack = &threadStack;
+        context.fillChildNodes = FillChildStates;
+    }
+
+    State child = doMove(state, move);
+    int rating = TreeSearch::MiniMaxAB(child, EvaluateState, GetChildStates, depth, false, getCurrentPlayer(state), Score::Should_Lose, Score::Guaranteed_Win, isFullTreeEvaluated, &context);
+
+    if(useThreadStack) context.stack = nullptr;
+    return rating;
+}
+
+const Move C4AI::MoveOrder[7] = { 3, 2, 4, 1, 5, 0, 6 };
+
 std::vector<State> C4AI::GetChildStates(const State &state)
 {
-    std::vector<State> children;
-    std::vector<Move> moves = getMoves(state);
-    for(Move m : moves) children.push_back(doMove(state, m));
+    std::vector<State> children(7);
+    children.resize(FillChildStates(state, children.data()));
     return children;
 }
 
+int C4AI::FillChildStates(const State &state, State * children)
+{
+    int moves = getMoveMask(toBitBoard(state));
+    int n = 0;
+    for(Move m : MoveOrder)
+        if(moves & (1 << m))
+            children[n++] = doMove(state, m);
+    return n;
+}
+
+void C4AI::EvaluateChildStates(const State & parent, const State * children, int count, const Player & positive, int * scores, bool * finished)
+{
+    // Children differ from their parent by a single disc, so their bitboards can be derived from the parent's.
+    // Every child is matched to its own move, which keeps scores in the order the children were passed in.
+    BitBoard boards[MAX_BATCH];
+    BitBoard board = toBitBoard(parent);
+    int n = std::min(count, MAX_BATCH);
+    for(int i = 0; i < n; i++) boards[i] = deriveChild(board, children[i]);
+    C4BatchEvaluator::Evaluate(boards, n, positive, scores, finished);
+}
+
+void C4AI::FindForcingMoves(const State & parent, const State * children, int count, bool * forcing)
+{
+    BitBoard before = toBitBoard(parent);
+    int mover = getCurrentPlayer(before) == Player::X ? 0 : 1;
+    uint64_t playable = (before.mask + C4BitBoard::BOTTOM) & C4BitBoard::BOARD;
+    uint64_t blocks = C4BitBoard::winningSlots(before.discs[1 - mover], before.mask) & playable;
+
+    for(int i = 0; i < count; i++) {
+        BitBoard after = deriveChild(before, children[i]);
+
+        // Blocks a win of the opponent?
+        if((before.mask ^ after.mask) & blocks) {
+            forcing[i] = true;
+            continue;
+        }
+
+        // Creates more wins than the opponent can block on its next move?
+        // A single threat is blocked right away, extending those as well makes the tree grow too much.
+        uint64_t wins = C4BitBoard::winningSlots(after.discs[mover], after.mask);
+        uint64_t next = (after.mask + C4BitBoard::BOTTOM) & C4BitBoard::BOARD;
+        forcing[i] = __builtin_popcountll(wins & next) >= 2 || (wins & next & (wins >> 1));
+    }
+}
+
 int C4AI::RatePrimaryHeuristic(const State &state, const Player &positive)
 {
     if(getMoves(state).empty()) return RateFinishedGame(state, positive);
-    int trapScore = RateByPotentialTraps(state, positive);
+    int trapScore = C4PatternEvaluator::RateTraps(state, positive);
     return trapScore;
 }
 
 int C4AI::RateSecondaryHeuristic(const State &state, const Player &positive) {
     if(getMoves(state).empty()) return RateFinishedGame(state, positive);
-    else return RateByPotentialFours(state, positive);
+    else return C4PatternEvaluator::RateWindows(state, positive);
 }
 
 int C4AI::RateByPotentialFours(const State &state, const Player &positive) {
@@ -196,8 +382,8 @@ int C4AI::RateByPotentialFours(const State &state, const Player &positive) {
                         if(state[row+1][col+1] != opp && state[row+2][col+2] != opp && state[row+3][col+3] != opp) {
                             rating += mod*Heur_P4_Abs_D;
                             if(state[row+1][col+1] == coin) rating += mod*Heur_P4_Abs_D; // Found another coin of player in potential c4
-                            if(state[row+2][col+1] == coin) rating += mod*Heur_P4_Abs_D; // Found another coin of player in potential c4
-                            if(state[row+3][col+1] == coin) rating += mod*Heur_P4_Abs_D; // Found another coin of player in potential c4
+                            if(state[row+2][col+2] == coin) rating += mod*Heur_P4_Abs_D; // Found another coin of player in potential c4
+                            if(state[row+3][col+3] == coin) rating += mod*Heur_P4_Abs_D; // Found another coin of player in potential c4
                         }
                 }
             } else goto topOfRowFound; // There's no more coins in this row, continue outer loop to check next column
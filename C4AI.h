@@ -3,6 +3,7 @@
 #define C4AI_H
 
 #include "C4Bot.h"
+#include "TreeSearch.h"
 
 /// This class defines some Heuristic functions to analyse game-states in connect4.
 /// These functions may be used alongside some search algorithm when winning states
@@ -14,13 +15,23 @@ class C4AI {
         Min = -999999, Max = 999999,
         Neutral = 0, Guaranteed_Win = 1000, Should_Lose = -1000,
         Heur_P4_Me = 1, Heur_P4_Opp = -1, Heur_P4_Abs_V = 1, Heur_P4_Abs_H = 2, Heur_P4_Abs_D = 2,
+        Heur_P4_Parity = 0, // Not used by 'RateByPotentialFours', see PatternWeights
         Heur_T_Row_Height_Mod = 1
     };
 
+    /// Order in which moves are searched, from the center column outwards as central moves tend to be the better ones.
+    static const Move MoveOrder[7];
+
+    friend class C4BatchEvaluator;
+    friend class C4PatternEvaluator;
+
 public:
     /// C4AI will return the move it expects to be optimal for the player ...
     /// that's supposed to make a move according to passed Match state object.
-    static Move FindBestMove(const Match & state);
+    /// Passes that can't be finished before the matches' turn deadline are aborted.
+    /// The expected line of play is remembered in the match, when the opponent follows it
+    /// the next search resumes at the depth this one reached (requires a transposition table).
+    static Move FindBestMove(Match & state, const SearchResources & resources = SearchResources());
 
     /// Evaluates a state, if a Guaranteed win isn't found it will return ...
     /// the passed states Heuristic score according to 'RateTotalHeuristic'.
@@ -36,17 +47,39 @@ public:
     static int RateSecondaryHeuristic(const State &state, const Player &positive);
 
     /// Rates board by amount of coins that can still be connected to a win.
+    /// Reference implementation, searches use the equivalent C4PatternEvaluator::RateWindows.
     static int RateByPotentialFours(const State &state, const Player &positive);
 
     /// Rates board semi-recursively by finding traps of 3 coins that can ...
     /// turn into 4 when a coin is dropped under them.
+    /// Reference implementation, searches use the equivalent C4PatternEvaluator::RateTraps.
     static int RateByPotentialTraps(const State &state, const Player &positive);
 
-    /// Gets all states that may result from the passed state after a single move
+    /// Gets all states that may result from the passed state after a single move, in the order of 'MoveOrder'.
     static std::vector<State> GetChildStates(const State & state);
 
+    /// Same as 'GetChildStates', writing the (at most 7) children to passed array instead. Returns the amount of children.
+    static int FillChildStates(const State & state, State * children);
+
+    /// Evaluates children of a state (in any order, at most MAX_BATCH) at once, see C4BatchEvaluator.
+    /// Scores are the same as those of 'EvaluateState', 'finished' is set for children without moves left.
+    static void EvaluateChildStates(const State & parent, const State * children, int count, const Player & positive, int * scores, bool * finished);
+
+    /// A move is forcing if it blocks a win the opponent could have made on its next move,
+    /// or if it creates a win the opponent has to block on its next move. Marks which of passed children were reached by a forcing move.
+    /// Only the parent is converted to a bitboard, those of the children (in any order) are derived from it.
+    static void FindForcingMoves(const State & parent, const State * children, int count, bool * forcing);
+
+    /// Rates a single move of passed state by searching it with a depth of <depth>,
+    /// from the perspective of the player that's making the move.
+    /// Unless the context has a stack of its own the search uses one that is preallocated for each thread.
+    static int RateMove(const State & state, const Move & move, int depth, SearchContext<State> & context, bool * isFullTreeEvaluated);
+
     static int RateFinishedGame(const State & state, const Player & positive);
 
+    /// Unique key of a state as evaluated by 'EvaluateState' for passed player, used for transposition tables.
+    static uint64_t HashState(const State & state, const Player & positive);
+
 };
 
 #endif
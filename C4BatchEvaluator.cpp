@@ -0,0 +1,187 @@
+#include "C4BatchEvaluator.h"
+
+#include <algorithm>
+
+#include "C4AI.h"
+#include "C4PatternEvaluator.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define C4_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+using namespace C4BitBoard;
+
+namespace {
+    /// Result of a kernel for a single position
+    struct Masks {
+        uint64_t trapsX;    // Empty slots that complete a connection of 4 for Player::X, but not for Player::O
+        uint64_t trapsO;    // Empty slots that complete a connection of 4 for Player::O, but not for Player::X
+        bool fourX;
+        bool fourO;
+    };
+
+    void KernelScalar(const BitBoard * boards, int count, Masks * out)
+    {
+        for(int i = 0; i < count; i++) {
+            uint64_t winX = winningSlots(boards[i].discs[0], boards[i].mask);
+            uint64_t winO = winningSlots(boards[i].discs[1], boards[i].mask);
+            out[i].trapsX = winX & ~winO;
+            out[i].trapsO = winO & ~winX;
+            out[i].fourX = hasFour(boards[i].discs[0]);
+            out[i].fourO = hasFour(boards[i].discs[1]);
+        }
+    }
+
+#ifdef C4_AVX2_KERNEL
+    #define SL(v, n) _mm256_slli_epi64(v, n)
+    #define SR(v, n) _mm256_srli_epi64(v, n)
+    #define AND(a, b) _mm256_and_si256(a, b)
+    #define OR(a, b) _mm256_or_si256(a, b)
+
+    /// Lane-wise equivalent of C4BitBoard::hasFour, lanes with a connection of 4 are non-zero
+    __attribute__((target("avx2"))) inline __m256i FourAVX2(__m256i d)
+    {
+        __m256i m = AND(d, SR(d, STRIDE));
+        __m256i r = AND(m, SR(m, 2 * STRIDE));
+        m = AND(d, SR(d, STRIDE - 1));
+        r = OR(r, AND(m, SR(m, 2 * (STRIDE - 1))));
+        m = AND(d, SR(d, STRIDE + 1));
+        r = OR(r, AND(m, SR(m, 2 * (STRIDE + 1))));
+        m = AND(d, SR(d, 1));
+        return OR(r, AND(m, SR(m, 2)));
+    }
+
+    /// Lane-wise equivalent of C4BitBoard::winningSlots, without masking out occupied slots
+    __attribute__((target("avx2"))) inline __m256i WinsAVX2(__m256i d)
+    {
+        __m256i r = AND(AND(SL(d, 1), SL(d, 2)), SL(d, 3));
+
+        __m256i p = AND(SL(d, STRIDE), SL(d, 2 * STRIDE));
+        r = OR(r, AND(p, SL(d, 3 * STRIDE)));
+        r = OR(r, AND(p, SR(d, STRIDE)));
+        p = AND(SR(d, STRIDE), SR(d, 2 * STRIDE));
+        r = OR(r, AND(p, SL(d, STRIDE)));
+        r = OR(r, AND(p, SR(d, 3 * STRIDE)));
+
+        p = AND(SL(d, STRIDE - 1), SL(d, 2 * (STRIDE - 1)));
+        r = OR(r, AND(p, SL(d, 3 * (STRIDE - 1))));
+        r = OR(r, AND(p, SR(d, STRIDE - 1)));
+        p = AND(SR(d, STRIDE - 1), SR(d, 2 * (STRIDE - 1)));
+        r = OR(r, AND(p, SL(d, STRIDE - 1)));
+        r = OR(r, AND(p, SR(d, 3 * (STRIDE - 1))));
+
+        p = AND(SL(d, STRIDE + 1), SL(d, 2 * (STRIDE + 1)));
+        r = OR(r, AND(p, SL(d, 3 * (STRIDE + 1))));
+        r = OR(r, AND(p, SR(d, STRIDE + 1)));
+        p = AND(SR(d, STRIDE + 1), SR(d, 2 * (STRIDE + 1)));
+        r = OR(r, AND(p, SL(d, STRIDE + 1)));
+        r = OR(r, AND(p, SR(d, 3 * (STRIDE + 1))));
+
+        return r;
+    }
+
+    __attribute__((target("avx2"))) void KernelAVX2(const BitBoard * boards, int count, Masks * out)
+    {
+        for(int base = 0; base < count; base += 4) {
+            int n = std::min(4, count - base);
+            alignas(32) uint64_t x[4] = { 0, 0, 0, 0 };
+            alignas(32) uint64_t o[4] = { 0, 0, 0, 0 };
+            alignas(32) uint64_t mask[4] = { 0, 0, 0, 0 };
+            for(int i = 0; i < n; i++) {
+                x[i] = boards[base + i].discs[0];
+                o[i] = boards[base + i].discs[1];
+                mask[i] = boards[base + i].mask;
+            }
+
+            __m256i vx = _mm256_load_si256((const __m256i *) x);
+            __m256i vo = _mm256_load_si256((const __m256i *) o);
+            __m256i empty = _mm256_andnot_si256(_mm256_load_si256((const __m256i *) mask), _mm256_set1_epi64x((long long) BOARD));
+
+            __m256i winX = AND(WinsAVX2(vx), empty);
+            __m256i winO = AND(WinsAVX2(vo), empty);
+            __m256i zero = _mm256_setzero_si256();
+
+            alignas(32) uint64_t trapsX[4], trapsO[4], noFourX[4], noFourO[4];
+            _mm256_store_si256((__m256i *) trapsX, _mm256_andnot_si256(winO, winX));
+            _mm256_store_si256((__m256i *) trapsO, _mm256_andnot_si256(winX, winO));
+            _mm256_store_si256((__m256i *) noFourX, _mm256_cmpeq_epi64(FourAVX2(vx), zero));
+            _mm256_store_si256((__m256i *) noFourO, _mm256_cmpeq_epi64(FourAVX2(vo), zero));
+
+            for(int i = 0; i < n; i++) {
+                out[base + i].trapsX = trapsX[i];
+                out[base + i].trapsO = trapsO[i];
+                out[base + i].fourX = !noFourX[i];
+                out[base + i].fourO = !noFourO[i];
+            }
+        }
+    }
+
+    #undef SL
+    #undef SR
+    #undef AND
+    #undef OR
+#endif
+
+    /// Equivalent of C4AI::RateByPotentialTraps for the traps of a single player:
+    /// every trap is worth its row (counted from the top) plus the height of its column.
+    int RateTraps(uint64_t traps, uint64_t mask)
+    {
+        // Sum of bit positions within each column, decomposed into the binary digits of those positions
+        const uint64_t bit0 = BOTTOM * 0x2A, bit1 = BOTTOM * 0x0C, bit2 = BOTTOM * 0x30;
+        int bitRows = __builtin_popcountll(traps & bit0) + 2 * __builtin_popcountll(traps & bit1) + 4 * __builtin_popcountll(traps & bit2);
+
+        int heights = 0;
+        for(int c = 0; c < WIDTH; c++)
+            heights += __builtin_popcountll(traps & columnMask(c)) * __builtin_popcountll(mask & columnMask(c));
+
+        return (HEIGHT - 1) * __builtin_popcountll(traps) - bitRows + heights;
+    }
+}
+
+void C4BatchEvaluator::Evaluate(const BitBoard * boards, int count, const Player & positive, int * scores, bool * finished)
+{
+    static const Kernel best = Best();
+    Evaluate(best, boards, count, positive, scores, finished);
+}
+
+void C4BatchEvaluator::Evaluate(Kernel kernel, const BitBoard * boards, int count, const Player & positive, int * scores, bool * finished)
+{
+    Masks masks[MAX_BATCH];
+    count = std::min(count, MAX_BATCH);
+
+#ifdef C4_AVX2_KERNEL
+    static const bool supported = Best() == Kernel::AVX2;
+    if(kernel == Kernel::AVX2 && supported) KernelAVX2(boards, count, masks);
+    else KernelScalar(boards, count, masks);
+#else
+    KernelScalar(boards, count, masks);
+#endif
+
+    for(int i = 0; i < count; i++) {
+        Player winner = masks[i].fourX ? Player::X : masks[i].fourO ? Player::O : Player::None;
+        bool full = boards[i].mask == BOARD;
+        finished[i] = winner != Player::None || full;
+
+        if(winner == positive) scores[i] = C4AI::Score::Guaranteed_Win;
+        else if(winner != Player::None) scores[i] = C4AI::Score::Should_Lose;
+        else if(full) scores[i] = C4AI::Score::Neutral;
+        else {
+            int score = RateTraps(masks[i].trapsX, boards[i].mask) - RateTraps(masks[i].trapsO, boards[i].mask);
+            scores[i] = (positive == Player::X ? score : -score) * C4PatternEvaluator::Active().weights.trapHeight;
+        }
+    }
+}
+
+C4BatchEvaluator::Kernel C4BatchEvaluator::Best()
+{
+#ifdef C4_AVX2_KERNEL
+    if(__builtin_cpu_supports("avx2")) return Kernel::AVX2;
+#endif
+    return Kernel::Scalar;
+}
+
+const char * C4BatchEvaluator::Name(Kernel kernel)
+{
+    return kernel == Kernel::AVX2 ? "avx2" : "scalar";
+}
@@ -0,0 +1,31 @@
+#ifndef C4BATCHEVALUATOR_H
+#define C4BATCHEVALUATOR_H
+
+#include "C4BitBoard.h"
+#include "TreeSearch.h"
+
+/// Evaluates several bitboard positions at once, returning exactly what C4AI::EvaluateState would.
+/// Win checks and trap detection run in AVX2 lanes (4 positions per instruction) when the CPU supports it,
+/// otherwise a scalar implementation is used; the choice is made once at runtime.
+/// Positions in which both players have connected 4 are not supported, these can't occur in a legal game.
+class C4BatchEvaluator {
+public:
+    enum class Kernel {
+        Scalar,
+        AVX2
+    };
+
+    /// Evaluates <count> (at most MAX_BATCH) positions from the perspective of player <positive>.
+    /// 'finished' is set for positions without moves left (won or board full).
+    static void Evaluate(const BitBoard * boards, int count, const Player & positive, int * scores, bool * finished);
+
+    /// Same as above, using a specific kernel. (ie. to validate them against each other)
+    static void Evaluate(Kernel kernel, const BitBoard * boards, int count, const Player & positive, int * scores, bool * finished);
+
+    /// The fastest kernel the CPU supports
+    static Kernel Best();
+
+    static const char * Name(Kernel kernel);
+};
+
+#endif
@@ -0,0 +1,110 @@
+/// c4bench: searches a set of positions to a fixed depth with several search configurations,
+/// and reports the amount of nodes, time, nodes per second and selectivity statistics of each.
+/// Batched leaf evaluation uses the fastest kernel the CPU supports (see C4BatchEvaluator).
+///
+/// Usage: c4bench [-d depth] [-h megabytes] [position ...]
+/// - depth: search depth of every root move (default 8)
+/// - megabytes: size of a transposition table, cleared before every search (default 0, no table)
+/// - position: sequence of columns (0-6) played from an empty board, ie. "3342"; "-" for an empty board.
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "C4AI.h"
+#include "TranspositionTable.h"
+
+struct Configuration
+{
+    const char * name;
+    int reduction;
+    int maxExtensions;
+    bool batched;       // Evaluate leaves in batch (see C4BatchEvaluator)
+    bool stacked;       // Generate children into a preallocated stack (see SearchStack)
+};
+
+static const Configuration configurations[] = {
+        { "full-width", 0, 0, true, true },
+        { "reductions", Selectivity().reduction, 0, true, true },
+        { "extensions", 0, Selectivity().maxExtensions, true, true },
+        { "unbatched", Selectivity().reduction, Selectivity().maxExtensions, false, true },
+        { "unstacked", Selectivity().reduction, Selectivity().maxExtensions, true, false },
+        { "default", Selectivity().reduction, Selectivity().maxExtensions, true, true }
+};
+
+int main(int argc, char * argv[])
+{
+    int depth = 8;
+    size_t tableMegabytes = 0;
+    std::vector<std::string> positions;
+
+    for(int i = 1; i < argc; i++) {
+        if(!std::strcmp(argv[i], "-d") && i + 1 < argc) depth = std::stoi(argv[++i]);
+        else if(!std::strcmp(argv[i], "-h") && i + 1 < argc) tableMegabytes = std::stoul(argv[++i]);
+        else positions.push_back(argv[i]);
+    }
+    if(positions.empty()) positions = { "3", "3342", "334455", "3332224405", "23344521" };
+
+    std::unique_ptr<TranspositionTable> table;
+    if(tableMegabytes) table.reset(new TranspositionTable(tableMegabytes));
+
+    // A stack without frames makes every node allocate its children on the heap
+    SearchStack<State> stack;
+    SearchStack<State> noStack(0);
+    std::cout << "Search stack: " << stack.bytes() / 1024 << " KB";
+    if(table) std::cout << ", transposition table: " << table->bytes() / (1024 * 1024) << " MB"
+                        << (table->hugePages() ? " (huge pages requested)" : "");
+    std::cout << std::endl;
+
+    for(const Configuration &config : configurations) {
+        SearchContext<State> total;
+        double totalSeconds = 0;
+        std::cout << config.name << " (reduction " << config.reduction << ", extensions " << config.maxExtensions
+                  << (config.batched ? ", batched evaluation" : "") << (config.stacked ? ", stack" : "") << "):" << std::endl;
+
+        for(const std::string &moves : positions) {
+            State root;
+            if(!parsePosition(moves, root)) {
+                std::cerr << "Invalid position: " << moves << std::endl;
+                return 2;
+            }
+            if(table) table->clear();
+
+            SearchContext<State> context;
+            context.table = table.get();
+            context.hash = C4AI::HashState;
+            context.findForcing = C4AI::FindForcingMoves;
+            if(config.batched) context.evaluateChildren = C4AI::EvaluateChildStates;
+            context.stack = config.stacked ? &stack : &noStack;
+            context.fillChildNodes = C4AI::FillChildStates;
+            context.selectivity.reduction = config.reduction;
+            context.selectivity.maxExtensions = config.maxExtensions;
+
+            Move best = -1;
+            int bestRating = 0;
+            auto start = std::chrono::steady_clock::now();
+            for(Move m : getMoves(root)) {
+                bool fullTreeEvaluated = true;
+                int rating = C4AI::RateMove(root, m, depth, context, &fullTreeEvaluated);
+                if(best == -1 || rating > bestRating) {
+                    best = m;
+                    bestRating = rating;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            total.addStatistics(context);
+            totalSeconds += seconds;
+
+            std::cout << "  " << moves << ": move " << best << " (" << bestRating << "), " << context.nodes << " nodes in "
+                      << (long long) (seconds * 1000) << " ms, " << context.reductions << " reductions, "
+                      << context.researches << " re-searches, " << context.extensions << " extensions" << std::endl;
+        }
+
+        std::cout << "  total: " << total.nodes << " nodes in " << (long long) (totalSeconds * 1000) << " ms ("
+                  << (long long) (totalSeconds > 0 ? total.nodes / totalSeconds : 0) << " nodes/s)" << std::endl;
+    }
+
+    return 0;
+}
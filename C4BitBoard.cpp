@@ -0,0 +1,81 @@
+#include "C4BitBoard.h"
+
+using namespace C4BitBoard;
+
+BitBoard toBitBoard(const State &state)
+{
+    BitBoard board;
+    for (int r = 0; r < HEIGHT; r++) {
+        for (int c = 0; c < WIDTH; c++) {
+            if (state[r][c] == Player::X) board.discs[0] |= slotMask(r, c);
+            else if (state[r][c] == Player::O) board.discs[1] |= slotMask(r, c);
+        }
+    }
+    board.mask = board.discs[0] | board.discs[1];
+    return board;
+}
+
+State toState(const BitBoard &board)
+{
+    State state = { { { { Player::None } } } };
+    for (int r = 0; r < HEIGHT; r++) {
+        for (int c = 0; c < WIDTH; c++) {
+            if (board.discs[0] & slotMask(r, c)) state[r][c] = Player::X;
+            else if (board.discs[1] & slotMask(r, c)) state[r][c] = Player::O;
+        }
+    }
+    return state;
+}
+
+Player getCurrentPlayer(const BitBoard &board)
+{
+    return __builtin_popcountll(board.discs[0]) > __builtin_popcountll(board.discs[1]) ? Player::O : Player::X;
+}
+
+BitBoard doMove(const BitBoard &board, const Move &m)
+{
+    if (board.mask & topMask(m)) return board; // Invalid move
+
+    BitBoard result = board;
+    uint64_t slot = (board.mask + bottomMask(m)) & columnMask(m);
+    result.discs[getCurrentPlayer(board) == Player::X ? 0 : 1] |= slot;
+    result.mask |= slot;
+    return result;
+}
+
+Player getWinner(const BitBoard &board)
+{
+    // Positions in which both players have connected 4 can't be reached in a legal game,
+    // getWinner(const State &) would return whichever connection it finds first.
+    if (hasFour(board.discs[0])) return Player::X;
+    if (hasFour(board.discs[1])) return Player::O;
+    return Player::None;
+}
+
+int getMoveMask(const BitBoard &board)
+{
+    if (getWinner(board) != Player::None) return 0;
+
+    int moves = 0;
+    for (int c = 0; c < WIDTH; c++)
+        if (!(board.mask & topMask(c)))
+            moves |= 1 << c;
+    return moves;
+}
+
+std::vector<Move> getMoves(const BitBoard &board)
+{
+    std::vector<Move> moves;
+    int moveMask = getMoveMask(board);
+    for (int c = 0; c < WIDTH; c++)
+        if (moveMask & (1 << c))
+            moves.push_back(c);
+    return moves;
+}
+
+uint64_t getKey(const BitBoard &board)
+{
+    // Adding the bottom row on top of the mask marks the height of every column with a single bit,
+    // the discs of player X below that bit are then enough to tell the entire position.
+    return board.discs[0] + board.mask + BOTTOM;
+}
@@ -0,0 +1,99 @@
+#ifndef C4BITBOARD_H
+#define C4BITBOARD_H
+
+#include <cstdint>
+#include <vector>
+
+#include "C4Game.h"
+
+/// Bitboard representation of a connect4 game-state.
+/// Every column takes 7 bits, the lowest bit being the bottom slot of that column;
+/// the 7th bit of each column is a sentinel that is never set, so lines can't wrap over columns.
+/// Slot [row][column] of a 'State' maps to bit (column * 7 + (5 - row)).
+/// The functions declared here are drop-in replacements for those in C4Game.h,
+/// and are expected to behave exactly the same for every position reachable in a legal game.
+/// (Validated by the 'c4perft' target)
+struct BitBoard
+{
+    uint64_t discs[2] = { 0, 0 };   // Slots occupied by Player::X and Player::O, respectively
+    uint64_t mask = 0;              // All occupied slots
+};
+
+namespace C4BitBoard
+{
+    const int WIDTH = 7;
+    const int HEIGHT = 6;
+    const int STRIDE = HEIGHT + 1;
+
+    const uint64_t BOTTOM = 0x0040810204081ULL;             // Bottom slot of every column
+    const uint64_t BOARD = BOTTOM * ((1ULL << HEIGHT) - 1); // Every playable slot
+
+    inline uint64_t bottomMask(int column) { return 1ULL << (column * STRIDE); }
+    inline uint64_t topMask(int column) { return 1ULL << (column * STRIDE + HEIGHT - 1); }
+    inline uint64_t columnMask(int column) { return ((1ULL << HEIGHT) - 1) << (column * STRIDE); }
+    inline uint64_t slotMask(int row, int column) { return 1ULL << (column * STRIDE + (HEIGHT - 1 - row)); }
+
+    /// Returns true if passed discs contain at least one connection of 4
+    inline bool hasFour(uint64_t d)
+    {
+        uint64_t m = d & (d >> STRIDE);                 // Horizontal
+        if(m & (m >> (2 * STRIDE))) return true;
+        m = d & (d >> (STRIDE - 1));                    // Diagonal (rising to the west)
+        if(m & (m >> (2 * (STRIDE - 1)))) return true;
+        m = d & (d >> (STRIDE + 1));                    // Diagonal (rising to the east)
+        if(m & (m >> (2 * (STRIDE + 1)))) return true;
+        m = d & (d >> 1);                               // Vertical
+        return (m & (m >> 2)) != 0;
+    }
+
+    /// Returns all empty slots that would complete a connection of 4 for passed discs,
+    /// regardless of whether they can be played right now.
+    inline uint64_t winningSlots(uint64_t d, uint64_t mask)
+    {
+        // Vertical
+        uint64_t r = (d << 1) & (d << 2) & (d << 3);
+
+        // Horizontal
+        uint64_t p = (d << STRIDE) & (d << 2 * STRIDE);
+        r |= p & (d << 3 * STRIDE);
+        r |= p & (d >> STRIDE);
+        p = (d >> STRIDE) & (d >> 2 * STRIDE);
+        r |= p & (d << STRIDE);
+        r |= p & (d >> 3 * STRIDE);
+
+        // Diagonal (rising to the west)
+        p = (d << (STRIDE - 1)) & (d << 2 * (STRIDE - 1));
+        r |= p & (d << 3 * (STRIDE - 1));
+        r |= p & (d >> (STRIDE - 1));
+        p = (d >> (STRIDE - 1)) & (d >> 2 * (STRIDE - 1));
+        r |= p & (d << (STRIDE - 1));
+        r |= p & (d >> 3 * (STRIDE - 1));
+
+        // Diagonal (rising to the east)
+        p = (d << (STRIDE + 1)) & (d << 2 * (STRIDE + 1));
+        r |= p & (d << 3 * (STRIDE + 1));
+        r |= p & (d >> (STRIDE + 1));
+        p = (d >> (STRIDE + 1)) & (d >> 2 * (STRIDE + 1));
+        r |= p & (d << (STRIDE + 1));
+        r |= p & (d >> 3 * (STRIDE + 1));
+
+        return r & (BOARD ^ mask);
+    }
+}
+
+BitBoard toBitBoard(const State &state);
+State toState(const BitBoard &board);
+
+Player getCurrentPlayer(const BitBoard &board);
+BitBoard doMove(const BitBoard &board, const Move &m);
+Player getWinner(const BitBoard &board);
+std::vector<Move> getMoves(const BitBoard &board);
+
+/// Returns a bitmask of all playable columns (bit i set means column i may be played),
+/// this is the allocation-free equivalent of getMoves().
+int getMoveMask(const BitBoard &board);
+
+/// Returns a key that uniquely identifies the position on the board (using 49 bits).
+uint64_t getKey(const BitBoard &board);
+
+#endif
@@ -5,25 +5,30 @@
 
 #include "C4AI.h"
 
-void C4Bot::move(int timeout) {
-    match.turnStartTime = std::chrono::steady_clock::now();
+C4Bot::C4Bot(const SearchResources &resources) : resources(resources) {}
+
+void C4Bot::move(int timeout, std::ostream &out, std::chrono::time_point<std::chrono::steady_clock> received) {
+    match.turnStartTime = received;
+    match.timebank = timeout;
+    std::ostream &log = *resources.log;
 
     C4AI::RateByPotentialTraps(match.board, getCurrentPlayer(match.board));
 
-    std::cerr << "---------------------------------------------------------------------------------------" << std::endl;
-    std::cerr << "STARTING MOVE-SEARCH FOR ROUND #" << match.round << " as Player " << getCurrentPlayer(match.board) << "." << std::endl;
-    std::cerr << "---------------------------------------------------------------------------------------" << std::endl;
+    log << "---------------------------------------------------------------------------------------" << std::endl;
+    log << "STARTING MOVE-SEARCH FOR ROUND #" << match.round << " as Player " << getCurrentPlayer(match.board) << "." << std::endl;
+    log << "---------------------------------------------------------------------------------------" << std::endl;
 
-    Move m = C4AI::FindBestMove(match);
+    Move m = C4AI::FindBestMove(match, resources);
     auto ms = match.timeElapsedThisTurn();
 
-    std::cerr << "______________________________________________________________________________________________" << std::endl;
-    std::cerr << "Search yields optimal column to do move: #" << m << std::endl;
-    std::cerr << "Search for move finished in " << ms << " milliseconds." << std::endl;
-    std::cerr << "Awaiting next turn..." << std::endl;
-    std::cerr << "______________________________________________________________________________________________" << std::endl << std::endl;
+    log << "______________________________________________________________________________________________" << std::endl;
+    log << "Search yields optimal column to do move: #" << m << std::endl;
+    log << "Search for move finished in " << ms << " milliseconds." << std::endl;
+    log << "Awaiting next turn..." << std::endl;
+    log << "______________________________________________________________________________________________" << std::endl << std::endl;
 
-    std::cout << "place_disc " << m << std::endl;
+    out << "place_disc " << m << std::endl;
+    recordMove(m);
 }
 
 void C4Bot::run()
@@ -31,15 +36,25 @@ void C4Bot::run()
     std::string line;
     while (std::getline(std::cin, line))
     {
-        std::vector<std::string> command = split(line, ' ');
-        if (command[0] == "settings") setting(command[1], command[2]);
-        else if (command[0] == "update" && command[1] == "game") update(command[2], command[3]);
-        else if (command[0] == "action" && command[1] == "move") move(std::stoi(command[2]));
-        else std::cerr << "Unknown command: " << line << std::endl;
+        handle(split(line, ' '), std::cout);
     }
+    finish();
 }
 
-void C4Bot::update(std::string &key, std::string &value)
+void C4Bot::handle(const std::vector<std::string> &command, std::ostream &out,
+                   std::chrono::time_point<std::chrono::steady_clock> received)
+{
+    if (command.size() == 3 && command[0] == "settings") setting(command[1], command[2]);
+    else if (command.size() == 4 && command[0] == "update" && command[1] == "game") update(command[2], command[3]);
+    else if (command.size() == 3 && command[0] == "action" && command[1] == "move") move(std::stoi(command[2]), out, received);
+    else {
+        *resources.log << "Unknown command:";
+        for (const std::string &word : command) *resources.log << " " << word;
+        *resources.log << std::endl;
+    }
+}
+
+void C4Bot::update(const std::string &key, const std::string &value)
 {
     if (key == "round") match.round = std::stoi(value);
     else if (key == "field") {
@@ -47,6 +62,7 @@ void C4Bot::update(std::string &key, std::string &value)
         int col = 0;
         std::vector<std::string> fields = split(value, ',');
         for (std::string &field : fields) {
+            if (row == 6) break; // Cells past the last row don't fit the board
             if (field == "0") match.board[row][col] = Player::X;
             else if (field == "1") match.board[row][col] = Player::O;
             else match.board[row][col] = Player::None;
@@ -57,10 +73,11 @@ void C4Bot::update(std::string &key, std::string &value)
                 col = 0;
             }
         }
+        recordBoard();
     }
 }
 
-void C4Bot::setting(std::string &key, std::string &value)
+void C4Bot::setting(const std::string &key, const std::string &value)
 {
     if (key == "timebank")              match.timebank = std::stoi(value);
     else if (key == "time_per_move")    match.time_per_move = std::stoi(value);
@@ -75,6 +92,69 @@ void C4Bot::setting(std::string &key, std::string &value)
     }
 }
 
+void C4Bot::setRecorder(GameRecordWriter * writer)
+{
+    recorder = writer;
+}
+
+void C4Bot::finish()
+{
+    if (!recorder || recordFinished) return;
+    recordFinished = true;
+    if (recordBroken || recordedMoves.empty()) return;
+
+    GameRecord record(match);
+    record.moves = recordedMoves;
+    if (!recorder->write(record)) *resources.log << "ERROR: Could not write game record!" << std::endl;
+}
+
+void C4Bot::recordBoard()
+{
+    if (!recorder) return;
+
+    // A disc that disappeared means a new match has started
+    bool newMatch = false;
+    for (int r = 0; r < 6; r++)
+        for (int c = 0; c < 7; c++)
+            if (recorded[r][c] != Player::None && match.board[r][c] != recorded[r][c]) newMatch = true;
+    if (newMatch) {
+        finish();
+        recordedMoves.clear();
+        recorded = { { { { Player::None } } } };
+        recordFinished = false;
+        recordBroken = false;
+    }
+    if (recordFinished || recordBroken) return;
+
+    // Normally only the opponent's last disc is new, larger gaps (ie. joining a match halfway)
+    // are filled with some order of moves that leads to the same board.
+    while (recorded != match.board) {
+        Move found = -1;
+        for (Move m : getMoves(recorded)) {
+            State next = doMove(recorded, m);
+            for (int r = 0; r < 6; r++)
+                if (next[r][m] != recorded[r][m] && match.board[r][m] == next[r][m]) found = m;
+            if (found != -1) break;
+        }
+        if (found == -1) {
+            *resources.log << "WARNING: Moves leading to this board could not be reconstructed, match won't be recorded." << std::endl;
+            recordBroken = true;
+            return;
+        }
+        recordedMoves.push_back(found);
+        recorded = doMove(recorded, found);
+    }
+    if (getMoves(recorded).empty()) finish();
+}
+
+void C4Bot::recordMove(const Move &m)
+{
+    if (!recorder || recordFinished || recordBroken || recorded != match.board) return;
+    recordedMoves.push_back(m);
+    recorded = doMove(recorded, m);
+    if (getMoves(recorded).empty()) finish();
+}
+
 std::vector<std::string> C4Bot::split(const std::string &s, char delim)
 {
     std::vector<std::string> elems;
@@ -89,3 +169,7 @@ long long int Match::timeElapsedThisTurn() const {
             std::chrono::steady_clock::now() - turnStartTime
     ).count();
 }
+
+std::chrono::time_point<std::chrono::steady_clock> Match::turnDeadline() const {
+    return turnStartTime + std::chrono::milliseconds(time_per_move + timebank / 10);
+}
@@ -2,33 +2,90 @@
 #define C4BOT_H
 
 #include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
 
 #include "C4Game.h"
+#include "C4GameRecord.h"
+#include "TreeSearch.h"
+
+class ThreadPool;
+
+/// What the search of the previous turn found, lets the next turn continue where it left off.
+struct SearchMemory {
+    bool valid          = false;
+    State root          = { { { { Player::None } } } }; // Board the search started from
+    int depth           = 0;                            // Search depth of the last finished pass
+    std::vector<Move> line;                             // Principal variation: the move played, followed by the moves expected next
+    std::vector<Move> moves;                            // Moves of 'root' ...
+    std::vector<int> ratings;                           // ... and their ratings after the last finished pass
+};
 
 struct Match {
     State board         = { { { { Player::None } } } };
-    int timebank;                   // The time you can exceed a move with before being disqualified; Usually ~10000 ms
-    int time_per_move;              // Time per move; Usually 500 ms
-    int your_botid;                 // Your bots team; 0 means Player::X, 1 means Player::O
+    int timebank        = 10000;    // The time you can exceed a move with before being disqualified; Usually ~10000 ms
+    int time_per_move   = 500;      // Time per move; Usually 500 ms
+    int your_botid      = 0;        // Your bots team; 0 means Player::X, 1 means Player::O
     int round           = 0;        // The round of the match that is being played (every 2 moves = 1 round)
     std::string player_names[2];    // Names of competing Players/Bots
     std::string your_bot;           // The name of your bot?
+    SearchMemory previousSearch;    // Search of the last turn the bot moved in
 
     std::chrono::time_point<std::chrono::steady_clock> turnStartTime;
     long long int timeElapsedThisTurn() const;
 
+    /// Point in time a search for this turn has to be finished by, no matter what.
+    /// Allows a search to exceed 'time_per_move' by a tenth of what's left of the time-bank.
+    std::chrono::time_point<std::chrono::steady_clock> turnDeadline() const;
+
+};
+
+/// Resources a bot may share with other bots running in the same process, all of them are optional.
+struct SearchResources {
+    TranspositionTable * table  = nullptr;      // Search results are shared through this table
+    ThreadPool * pool           = nullptr;      // Root moves are searched in parallel on this pool
+    std::ostream * log          = &std::cerr;   // Search progress is logged to this stream
+    Selectivity selectivity;                    // Late move reductions and extensions of forcing moves
 };
 
 
 class C4Bot {
     Match match;
+    SearchResources resources;
+
+    GameRecordWriter * recorder = nullptr;
+    std::vector<Move> recordedMoves;                        // Moves of the current match so far
+    State recorded      = { { { { Player::None } } } };     // Position after 'recordedMoves'
+    bool recordFinished = false;                            // The current match has ended and has been written
+    bool recordBroken   = false;                            // The moves of the current match could not be reconstructed
 public:
+    C4Bot() = default;
+    explicit C4Bot(const SearchResources &resources);
+
     void run();
+
+    /// Every match this bot plays will be appended to passed writer. (may be shared by bots)
+    void setRecorder(GameRecordWriter * writer);
+
+    /// Writes the record of the current match if it hasn't been written yet, ie. when a match is abandoned.
+    /// Records are written automatically when a match ends in a win or draw.
+    void finish();
+
+    /// Handles a single command of the protocol (split by spaces), replies are written to 'out'.
+    /// The turn of an 'action move' command starts at 'received'.
+    void handle(const std::vector<std::string> &command, std::ostream &out,
+                std::chrono::time_point<std::chrono::steady_clock> received = std::chrono::steady_clock::now());
+
+    static std::vector<std::string> split(const std::string &s, char delim);
 private:
-    std::vector<std::string> split(const std::string &s, char delim);
-    void move(int timeout);
-    void setting(std::string &key, std::string &value);
-    void update(std::string &key, std::string &value);
+    void move(int timeout, std::ostream &out, std::chrono::time_point<std::chrono::steady_clock> received);
+    void setting(const std::string &key, const std::string &value);
+    void update(const std::string &key, const std::string &value);
+
+    /// Reconstructs the moves that lead from the recorded position to the current board
+    void recordBoard();
+    void recordMove(const Move &m);
 
 
 };
@@ -1,5 +1,6 @@
 #include "C4Game.h"
 
+#include <algorithm>
 #include <iostream>
 
 std::ostream & operator << (std::ostream& os, const Player &p)
@@ -91,3 +92,17 @@ std::vector<Move> getMoves(const State &state)
 				moves.push_back(i);
     return moves;
 }
+
+bool parsePosition(const std::string &moves, State &state)
+{
+    state = { { { { Player::None } } } };
+    if(moves == "-") return true;
+    for(char ch : moves) {
+        if(ch < '0' || ch > '6') return false;
+        Move m = ch - '0';
+        std::vector<Move> legal = getMoves(state);
+        if(std::find(legal.begin(), legal.end(), m) == legal.end()) return false;
+        state = doMove(state, m);
+    }
+    return true;
+}
@@ -3,6 +3,7 @@
 
 #include <random>
 #include <array>
+#include <string>
 
 enum class Player
 {
@@ -19,5 +20,8 @@ State doMove(const State &state, const Move &m);
 Player getWinner(const State &state);
 std::vector<Move> getMoves(const State &state);
 
+/// Plays a sequence of columns ("3342") from the empty board, "-" is the empty board itself. Returns false on illegal moves.
+bool parsePosition(const std::string &moves, State &state);
+
 #endif // C4_H
 
@@ -0,0 +1,146 @@
+#include "C4GameRecord.h"
+
+#include "C4Bot.h"
+
+namespace {
+    const unsigned char MAGIC = 0xC4;
+    const unsigned char VERSION = 1;
+    const int BITS_PER_MOVE = 3;
+    const uint64_t MAX_MOVES = 42;
+    const uint64_t MAX_STRING = 1 << 16;
+
+    void WriteVarint(std::string &out, uint64_t value)
+    {
+        while(value >= 0x80) {
+            out.push_back((char) ((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back((char) value);
+    }
+
+    bool ReadVarint(std::istream &in, uint64_t &value)
+    {
+        value = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if(byte == EOF) return false;
+            value |= (uint64_t) (byte & 0x7F) << shift;
+            if(!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    void WriteString(std::string &out, const std::string &s)
+    {
+        WriteVarint(out, s.size());
+        out += s;
+    }
+
+    bool ReadString(std::istream &in, std::string &s)
+    {
+        uint64_t length;
+        if(!ReadVarint(in, length) || length > MAX_STRING) return false;
+        s.resize(length);
+        return length == 0 || in.read(&s[0], length);
+    }
+}
+
+GameRecord::GameRecord(const Match &match)
+{
+    time_per_move = match.time_per_move;
+    timebank = match.timebank;
+    your_botid = match.your_botid;
+    player_names[0] = match.player_names[0];
+    player_names[1] = match.player_names[1];
+    your_bot = match.your_bot;
+}
+
+State GameRecord::position(size_t ply) const
+{
+    State state = { { { { Player::None } } } };
+    for(size_t i = 0; i < ply && i < moves.size(); i++) state = doMove(state, moves[i]);
+    return state;
+}
+
+GameRecordWriter::GameRecordWriter(const std::string &path) : file(path, std::ios::binary | std::ios::app) {}
+
+bool GameRecordWriter::write(const GameRecord &record)
+{
+    std::string bytes;
+    Serialize(record, bytes);
+
+    // A record is written at once, so records of concurrent matches never interleave
+    std::lock_guard<std::mutex> lock(mutex);
+    file.write(bytes.data(), bytes.size());
+    file.flush();
+    return (bool) file;
+}
+
+void GameRecordWriter::Serialize(const GameRecord &record, std::string &out)
+{
+    out.push_back((char) MAGIC);
+    out.push_back((char) VERSION);
+    WriteVarint(out, (uint64_t) record.time_per_move);
+    WriteVarint(out, (uint64_t) record.timebank);
+    WriteVarint(out, (uint64_t) record.your_botid);
+    WriteString(out, record.player_names[0]);
+    WriteString(out, record.player_names[1]);
+    WriteString(out, record.your_bot);
+    WriteVarint(out, record.moves.size());
+
+    unsigned int bits = 0;
+    int bitCount = 0;
+    for(Move m : record.moves) {
+        bits |= (unsigned int) m << bitCount;
+        bitCount += BITS_PER_MOVE;
+        if(bitCount >= 8) {
+            out.push_back((char) (bits & 0xFF));
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+    if(bitCount) out.push_back((char) bits);
+}
+
+GameRecordReader::GameRecordReader(std::istream &in) : in(in) {}
+
+bool GameRecordReader::next(GameRecord &record)
+{
+    int magic = in.get();
+    if(magic == EOF) return false;
+
+    record = GameRecord();
+    uint64_t timePerMove, timebank, botId, moveCount;
+    isCorrupt = magic != MAGIC || in.get() != VERSION
+            || !ReadVarint(in, timePerMove) || !ReadVarint(in, timebank) || !ReadVarint(in, botId)
+            || !ReadString(in, record.player_names[0]) || !ReadString(in, record.player_names[1]) || !ReadString(in, record.your_bot)
+            || !ReadVarint(in, moveCount) || moveCount > MAX_MOVES;
+    if(isCorrupt) return false;
+
+    record.time_per_move = (int) timePerMove;
+    record.timebank = (int) timebank;
+    record.your_botid = (int) botId;
+
+    unsigned int bits = 0;
+    int bitCount = 0;
+    for(uint64_t i = 0; i < moveCount; i++) {
+        if(bitCount < BITS_PER_MOVE) {
+            int byte = in.get();
+            if(byte == EOF) {
+                isCorrupt = true;
+                return false;
+            }
+            bits |= (unsigned int) byte << bitCount;
+            bitCount += 8;
+        }
+        Move m = (Move) (bits & ((1 << BITS_PER_MOVE) - 1));
+        if(m > 6) {
+            isCorrupt = true;
+            return false;
+        }
+        record.moves.push_back(m);
+        bits >>= BITS_PER_MOVE;
+        bitCount -= BITS_PER_MOVE;
+    }
+    return true;
+}
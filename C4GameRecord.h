@@ -0,0 +1,71 @@
+#ifndef C4GAMERECORD_H
+#define C4GAMERECORD_H
+
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "C4Game.h"
+
+struct Match;
+
+/// A finished (or abandoned) match: its settings and every move played, starting at an empty board.
+///
+/// Binary format of a single record, records are simply appended to each other:
+/// - 1 byte: magic (0xC4)
+/// - 1 byte: format version (1)
+/// - varint: time_per_move, timebank, your_botid
+/// - 3 strings: player_names[0], player_names[1], your_bot (each a varint length followed by its bytes)
+/// - varint: amount of moves
+/// - moves: 3 bits per move, least significant bits first, padded to whole bytes
+/// Varints store 7 bits per byte, least significant first; the highest bit marks that another byte follows.
+struct GameRecord {
+    std::vector<Move> moves;
+    int time_per_move = 0;
+    int timebank = 0;               // Time-bank left when the record was made
+    int your_botid = 0;
+    std::string player_names[2];
+    std::string your_bot;
+
+    GameRecord() = default;
+
+    /// Record of passed matches' settings, without moves
+    explicit GameRecord(const Match &match);
+
+    /// The position after the first <ply> moves
+    State position(size_t ply) const;
+};
+
+/// Appends records to a file, may be shared by any amount of threads.
+class GameRecordWriter {
+public:
+    explicit GameRecordWriter(const std::string &path);
+
+    /// Appends a record, returns false if it could not be written
+    bool write(const GameRecord &record);
+
+    static void Serialize(const GameRecord &record, std::string &out);
+
+private:
+    std::mutex mutex;
+    std::ofstream file;
+};
+
+/// Reads records one by one from any stream, so files of any size can be scanned.
+class GameRecordReader {
+public:
+    explicit GameRecordReader(std::istream &in);
+
+    /// Reads the next record, returns false at the end of the stream or when the stream is corrupt (see 'corrupt')
+    bool next(GameRecord &record);
+
+    bool corrupt() const { return isCorrupt; }
+
+private:
+    std::istream &in;
+    bool isCorrupt = false;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "C4PatternEvaluator.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace {
+    const int ROWS = 6;
+    const int COLUMNS = 7;
+    const int WINDOW_COUNT = 69;
+
+    /// 4 slots in a row, slots are indices of cells (row * COLUMNS + column)
+    struct Window {
+        int slots[4];
+        uint64_t bits[5];   // Bit of each slots' cell, followed by 0 (see PatternTable::trapX)
+        int direction;  // Index of PatternTable's directions
+        int odd;        // Row of the lowest slot is odd, counted from the bottom starting at 1
+        int values;     // Offset of this windows' values within PatternTable::windows[positive]
+    };
+
+    /// All windows of the board, in the directions of PatternTable
+    struct Windows {
+        Window windows[WINDOW_COUNT] = {};
+
+        constexpr Windows()
+        {
+            const int steps[PatternTable::DIRECTIONS][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 } };  // row, column
+            int n = 0;
+            for(int direction = 0; direction < PatternTable::DIRECTIONS; direction++)
+                for(int row = 0; row + 3 * steps[direction][0] < ROWS; row++)
+                    for(int col = 0; col < COLUMNS; col++) {
+                        int lastCol = col + 3 * steps[direction][1];
+                        if(lastCol < 0 || lastCol >= COLUMNS) continue;
+
+                        Window &w = windows[n++];
+                        for(int i = 0; i < 4; i++) {
+                            w.slots[i] = (row + i * steps[direction][0]) * COLUMNS + col + i * steps[direction][1];
+                            w.bits[i] = 1ULL << w.slots[i];
+                        }
+                        w.direction = direction;
+                        w.odd = (ROWS - (row + 3 * steps[direction][0])) % 2;
+                        w.values = (direction * 2 + w.odd) * PatternTable::PATTERNS;
+                    }
+        }
+    };
+
+    constexpr Windows AllWindows;
+    constexpr PatternTable DefaultPatterns(C4PatternEvaluator::DefaultWeights());
+    static_assert(DefaultPatterns.trapX[1 + 3 + 9] == 3 && DefaultPatterns.trapO[1 + 3 + 9] == 4, "3 coins of Player::X followed by an empty slot are a trap of Player::X");
+    static_assert(AllWindows.windows[WINDOW_COUNT - 1].slots[3] == (ROWS - 1) * COLUMNS + 3, "All windows have been generated");
+
+    std::unique_ptr<PatternTable> loaded;
+    const PatternTable * active = &C4PatternEvaluator::DefaultTable;
+
+    /// Contents of every cell as a pattern digit
+    struct Cells {
+        uint8_t cells[ROWS * COLUMNS];
+        int heights[COLUMNS] = {};
+
+        explicit Cells(const State &state)
+        {
+            for(int row = 0; row < ROWS; row++)
+                for(int col = 0; col < COLUMNS; col++) {
+                    cells[row * COLUMNS + col] = (uint8_t) state[row][col];
+                    heights[col] += state[row][col] != Player::None;
+                }
+        }
+
+        int pattern(const Window &w) const
+        {
+            return cells[w.slots[0]] + 3 * cells[w.slots[1]] + 9 * cells[w.slots[2]] + 27 * cells[w.slots[3]];
+        }
+    };
+
+    /// Cells completing a 4 per player, and connected 4s (see PatternTable::fours)
+    struct Traps {
+        uint64_t x = 0;
+        uint64_t o = 0;
+        unsigned int fours = 0;
+
+        Traps(const Cells &cells, const PatternTable &table)
+        {
+            for(const Window &w : AllWindows.windows) {
+                int pattern = cells.pattern(w);
+                x |= w.bits[table.trapX[pattern]];
+                o |= w.bits[table.trapO[pattern]];
+                fours |= table.fours[pattern];
+            }
+        }
+
+        /// Every trap is worth its row (counted from the top) plus the height of its column, traps of both players are worth nothing
+        int score(const Cells &cells, const Player &positive, const PatternTable &table) const
+        {
+            int score = 0;
+            for(uint64_t only = x & ~o; only; only &= only - 1) {
+                int cell = __builtin_ctzll(only);
+                score += cell / COLUMNS + cells.heights[cell % COLUMNS];
+            }
+            for(uint64_t only = o & ~x; only; only &= only - 1) {
+                int cell = __builtin_ctzll(only);
+                score -= cell / COLUMNS + cells.heights[cell % COLUMNS];
+            }
+            return (positive == Player::X ? score : -score) * table.weights.trapHeight;
+        }
+    };
+}
+
+const PatternTable C4PatternEvaluator::DefaultTable = DefaultPatterns;
+
+const PatternTable & C4PatternEvaluator::Active()
+{
+    return *active;
+}
+
+void C4PatternEvaluator::Use(const PatternWeights &weights)
+{
+    loaded.reset(new PatternTable(weights));
+    active = loaded.get();
+}
+
+bool C4PatternEvaluator::Load(std::istream &in, PatternWeights &weights)
+{
+    std::string line;
+    while(std::getline(in, line)) {
+        std::istringstream words(line);
+        std::string name;
+        int value;
+        if(!(words >> name) || name[0] == '#') continue;
+        if(!(words >> value)) return false;
+
+        if(name == "me")                weights.me = value;
+        else if(name == "opp")          weights.opp = value;
+        else if(name == "vertical")     weights.vertical = value;
+        else if(name == "horizontal")   weights.horizontal = value;
+        else if(name == "diagonal")     weights.diagonal = value;
+        else if(name == "parity")       weights.parity = value;
+        else if(name == "trap_height")  weights.trapHeight = value;
+        else return false;
+    }
+    return true;
+}
+
+int C4PatternEvaluator::RateWindows(const State &state, const Player &positive, const PatternTable &table)
+{
+    Cells cells(state);
+    const int * values = &table.windows[positive == Player::O][0][0][0];
+    int rating = 0;
+    for(const Window &w : AllWindows.windows) rating += values[w.values + cells.pattern(w)];
+    return rating;
+}
+
+int C4PatternEvaluator::RateTraps(const State &state, const Player &positive, const PatternTable &table)
+{
+    Cells cells(state);
+    return Traps(cells, table).score(cells, positive, table);
+}
+
+int C4PatternEvaluator::Evaluate(const State &state, const Player &positive, const PatternTable &table)
+{
+    Cells cells(state);
+    Traps traps(cells, table);
+    if(traps.fours) {
+        Player winner = traps.fours & 1 ? Player::X : Player::O;
+        return winner == positive ? C4AI::Score::Guaranteed_Win : C4AI::Score::Should_Lose;
+    }
+
+    bool full = true;
+    for(int height : cells.heights) full = full && height == ROWS;
+    if(full) return C4AI::Score::Neutral;
+
+    return traps.score(cells, positive, table);
+}
@@ -0,0 +1,118 @@
+#ifndef C4PATTERNEVALUATOR_H
+#define C4PATTERNEVALUATOR_H
+
+#include <cstdint>
+#include <istream>
+
+#include "C4AI.h"
+
+/// Weights of the window heuristics. Defaults are those of C4AI's Score enum.
+struct PatternWeights {
+    int me;             // Multiplier of windows holding coins of the positive player only
+    int opp;            // Multiplier of windows holding coins of the opponent only
+    int vertical;       // Points per coin in a window that can still become a vertical 4
+    int horizontal;     // ... horizontal 4
+    int diagonal;       // ... diagonal 4
+    int parity;         // Bonus for 3 coins and an empty slot on a row its owner likes (odd rows for Player::X, even rows for Player::O, counted from the bottom)
+    int trapHeight;     // Multiplier of the trap heuristic
+};
+
+/// Value of every possible window of 4 slots, generated from a set of weights.
+/// A window's pattern is the base-3 number of its slots' contents (Player::None = 0, Player::X = 1, Player::O = 2), first slot least significant.
+/// Tables are generated at compile time from constant weights, ie.
+///     constexpr PatternTable table(PatternWeights { 1, -1, 1, 2, 2, 0, 1 });
+/// or at runtime from weights loaded at startup.
+struct PatternTable {
+    static const int PATTERNS = 81;
+    static const int DIRECTIONS = 4;    // Horizontal, vertical, diagonal down (\) and diagonal up (/)
+
+    PatternWeights weights;
+
+    /// [positive player is Player::O][direction][row of the windows' lowest slot is odd][pattern]: value of a window for the positive player
+    int windows[2][DIRECTIONS][2][PATTERNS] = {};
+
+    /// [pattern]: slot that completes a 4 of Player::X or Player::O respectively, 4 if there is none
+    uint8_t trapX[PATTERNS] = {};
+    uint8_t trapO[PATTERNS] = {};
+
+    /// [pattern]: 1 if the window is a 4 of Player::X, 2 if it is a 4 of Player::O
+    uint8_t fours[PATTERNS] = {};
+
+    constexpr explicit PatternTable(const PatternWeights &w) : weights(w)
+    {
+        for(int pattern = 0; pattern < PATTERNS; pattern++) {
+            int slots[4] = {};
+            int coins[3] = {};
+            for(int i = 0, rest = pattern; i < 4; i++, rest /= 3) {
+                slots[i] = rest % 3;
+                coins[slots[i]]++;
+            }
+
+            // Slot completing a 4: 3 coins of a single player and 1 empty slot
+            int owner = coins[1] == 3 && coins[0] == 1 ? 1 : coins[2] == 3 && coins[0] == 1 ? 2 : 0;
+            int open = 0;
+            for(int i = 0; i < 4; i++)
+                if(!slots[i]) open = i;
+            trapX[pattern] = (uint8_t) (owner == 1 ? open : 4);
+            trapO[pattern] = (uint8_t) (owner == 2 ? open : 4);
+            fours[pattern] = (uint8_t) (coins[1] == 4 ? 1 : coins[2] == 4 ? 2 : 0);
+
+            for(int o = 0; o < 2; o++)
+                for(int direction = 0; direction < DIRECTIONS; direction++)
+                    for(int odd = 0; odd < 2; odd++)
+                        windows[o][direction][odd][pattern] = rate(w, slots, coins, owner, open, o + 1, direction, odd);
+        }
+    }
+
+private:
+    /// Every coin at an end of a window that the opponent hasn't blocked gets a point for every coin of its owner in that window
+    static constexpr int rate(const PatternWeights &weights, const int * slots, const int * coins, int owner, int open, int positive, int direction, int odd)
+    {
+        int player = coins[1] && !coins[2] ? 1 : coins[2] && !coins[1] ? 2 : 0;
+        if(!player) return 0;
+
+        int ends = (slots[0] != 0) + (slots[3] != 0);
+        int points = direction == 0 ? weights.horizontal : direction == 1 ? weights.vertical : weights.diagonal;
+        int value = ends * coins[player] * points * (player == positive ? weights.me : weights.opp);
+
+        // Slots follow each other downwards in every direction but horizontal, the last slot is the lowest
+        int openOdd = direction == 0 ? odd : (odd + 3 - open) % 2;
+        if(owner && openOdd == (owner == 1 ? 1 : 0)) value += owner == positive ? weights.parity : -weights.parity;
+        return value;
+    }
+};
+
+/// Evaluates states by looking up all 69 windows of 4 slots in a pattern table, without branching on their contents.
+class C4PatternEvaluator {
+public:
+    /// Weights as defined by C4AI's Score enum
+    static constexpr PatternWeights DefaultWeights()
+    {
+        return PatternWeights { C4AI::Score::Heur_P4_Me, C4AI::Score::Heur_P4_Opp, C4AI::Score::Heur_P4_Abs_V, C4AI::Score::Heur_P4_Abs_H,
+                                C4AI::Score::Heur_P4_Abs_D, C4AI::Score::Heur_P4_Parity, C4AI::Score::Heur_T_Row_Height_Mod };
+    }
+
+    /// Table of the default weights, generated at compile time
+    static const PatternTable DefaultTable;
+
+    /// The table used by C4AI, the default table unless other weights were loaded.
+    static const PatternTable & Active();
+
+    /// Makes C4AI use passed weights from now on, should be called before any search starts.
+    static void Use(const PatternWeights &weights);
+
+    /// Reads weights from lines of "<name> <value>", names are those of PatternWeights' fields (trapHeight as trap_height).
+    /// Missing weights keep their value, lines starting with '#' are ignored. Returns false on unknown names or invalid values.
+    static bool Load(std::istream &in, PatternWeights &weights);
+
+    /// Equivalent of C4AI::RateByPotentialFours (plus the parity bonus)
+    static int RateWindows(const State &state, const Player &positive, const PatternTable &table = Active());
+
+    /// Equivalent of C4AI::RateByPotentialTraps
+    static int RateTraps(const State &state, const Player &positive, const PatternTable &table = Active());
+
+    /// Equivalent of C4AI::EvaluateState (win, loss or draw, otherwise 'RateTraps') in a single pass over the windows
+    static int Evaluate(const State &state, const Player &positive, const PatternTable &table = Active());
+};
+
+#endif
@@ -0,0 +1,323 @@
+/// c4perft: counts all positions reachable in exactly <depth> moves from given positions.
+/// Every move-generation implementation is run on the same positions, their results have to match
+/// those of the reference implementation in C4Game.cpp exactly. Throughput is reported as leaf positions per second.
+///
+/// With -e leaf evaluation is validated instead, on every position reachable in exactly <depth> moves and for both players:
+/// C4AI::EvaluateState (using C4PatternEvaluator) and every kernel of C4BatchEvaluator are compared to the hand-written
+/// heuristics of C4AI, as is C4PatternEvaluator::RateWindows to C4AI::RateByPotentialFours.
+///
+/// Usage: c4perft [-d depth] [-t threads] [-e] [position ...]
+/// - depth: amount of moves to look ahead (default 8)
+/// - threads: amount of worker threads, work is split by the moves available in the root position (default 1, 0 = all cores)
+/// - position: sequence of columns (0-6) played from an empty board, ie. "3342"; "-" for an empty board.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "C4Game.h"
+#include "C4AI.h"
+#include "C4BitBoard.h"
+#include "C4BatchEvaluator.h"
+#include "C4PatternEvaluator.h"
+
+struct PerftResult
+{
+    uint64_t leaves = 0;    // Positions at exactly the requested depth
+    uint64_t winsX = 0;     // Finished games (before requested depth was reached) won by Player::X
+    uint64_t winsO = 0;     // Finished games (before requested depth was reached) won by Player::O
+    uint64_t draws = 0;     // Finished games (before requested depth was reached) without winner
+
+    PerftResult & operator+=(const PerftResult &other)
+    {
+        leaves += other.leaves;
+        winsX += other.winsX;
+        winsO += other.winsO;
+        draws += other.draws;
+        return *this;
+    }
+
+    bool operator==(const PerftResult &other) const
+    {
+        return leaves == other.leaves && winsX == other.winsX && winsO == other.winsO && draws == other.draws;
+    }
+
+    void addFinished(Player winner)
+    {
+        if(winner == Player::X) winsX++;
+        else if(winner == Player::O) winsO++;
+        else draws++;
+    }
+};
+
+std::ostream &operator<<(std::ostream &os, const PerftResult &r)
+{
+    os << r.leaves << " leaves, " << r.winsX << "/" << r.winsO << "/" << r.draws << " won by X/won by O/drawn";
+    return os;
+}
+
+/// Reference implementation, uses nothing but the functions in C4Game.h
+static void PerftReference(const State &state, int depth, PerftResult &result)
+{
+    if(!depth) {
+        result.leaves++;
+        return;
+    }
+    std::vector<Move> moves = getMoves(state);
+    if(moves.empty()) {
+        result.addFinished(getWinner(state));
+        return;
+    }
+    for(Move m : moves) PerftReference(doMove(state, m), depth - 1, result);
+}
+
+/// Uses the bitboard equivalents of the functions in C4Game.h
+static void PerftBitBoard(const BitBoard &board, int depth, PerftResult &result)
+{
+    if(!depth) {
+        result.leaves++;
+        return;
+    }
+    int moves = getMoveMask(board);
+    if(!moves) {
+        result.addFinished(getWinner(board));
+        return;
+    }
+    for(int c = 0; c < C4BitBoard::WIDTH; c++)
+        if(moves & (1 << c)) PerftBitBoard(doMove(board, c), depth - 1, result);
+}
+
+/// Bitboard implementation that only checks the player who just moved for a win,
+/// and counts the leaves below depth 1 without generating them.
+static void PerftBitBoardFast(uint64_t mover, uint64_t mask, int depth, PerftResult &result)
+{
+    // 'mover' holds the discs of the player who made the last move.
+    if(C4BitBoard::hasFour(mover)) {
+        // Which player that is follows from parity, X always has more or as many discs as O.
+        result.addFinished(__builtin_popcountll(mask) & 1 ? Player::X : Player::O);
+        return;
+    }
+    uint64_t playable = (mask + C4BitBoard::BOTTOM) & C4BitBoard::BOARD;
+    if(!playable) {
+        result.addFinished(Player::None);
+        return;
+    }
+    if(depth == 1) {
+        result.leaves += __builtin_popcountll(playable);
+        return;
+    }
+    uint64_t opponent = mover ^ mask;
+    while(playable) {
+        uint64_t slot = playable & (~playable + 1);
+        playable ^= slot;
+        PerftBitBoardFast(opponent | slot, mask | slot, depth - 1, result);
+    }
+}
+
+static void RunReference(const State &state, int depth, PerftResult &result)
+{
+    PerftReference(state, depth, result);
+}
+
+static void RunBitBoard(const State &state, int depth, PerftResult &result)
+{
+    PerftBitBoard(toBitBoard(state), depth, result);
+}
+
+static void RunBitBoardFast(const State &state, int depth, PerftResult &result)
+{
+    if(!depth) {
+        result.leaves++;
+        return;
+    }
+    BitBoard board = toBitBoard(state);
+    uint64_t mover = board.discs[getCurrentPlayer(board) == Player::X ? 1 : 0];
+    PerftBitBoardFast(mover, board.mask, depth, result);
+}
+
+struct Implementation
+{
+    const char * name;
+    void (*perft)(const State &, int, PerftResult &);
+};
+
+static const Implementation implementations[] = {
+        { "reference", RunReference },
+        { "bitboard", RunBitBoard },
+        { "bitboard-fast", RunBitBoardFast }
+};
+
+/// Runs perft for passed implementation, splitting the work at the root over <threads> threads.
+static PerftResult RunSplit(const Implementation &impl, const State &root, int depth, int threads)
+{
+    PerftResult total;
+    std::vector<Move> moves = getMoves(root);
+    if(threads <= 1 || depth < 2 || moves.empty()) {
+        impl.perft(root, depth, total);
+        return total;
+    }
+
+    std::vector<PerftResult> results(moves.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads && t < (int) moves.size(); t++) {
+        workers.emplace_back([&]() {
+            for(size_t i = next++; i < moves.size(); i = next++)
+                impl.perft(doMove(root, moves[i]), depth - 1, results[i]);
+        });
+    }
+    for(std::thread &w : workers) w.join();
+    for(const PerftResult &r : results) total += r;
+    return total;
+}
+
+struct EvaluationResult
+{
+    uint64_t leaves = 0;
+    uint64_t mismatches = 0;
+    double seconds[6] = { 0, 0, 0, 0, 0, 0 };   // Time spent by every evaluator, see 'EvaluatorNames'
+};
+
+static const char * EvaluatorNames[] = { "reference", "pattern", "scalar", "avx2", "reference windows", "pattern windows" };
+
+/// C4AI::EvaluateState in terms of the hand-written trap heuristic
+static int ReferenceEvaluation(const State &state, const Player &positive)
+{
+    if(getWinner(state) != Player::None || getMoves(state).empty()) return C4AI::RateFinishedGame(state, positive);
+    return C4AI::RateByPotentialTraps(state, positive);
+}
+
+/// Runs an evaluation on every position, adding the time it took to <seconds>
+template <class F>
+static void Time(const std::vector<State> &states, int * scores, double &seconds, F evaluate)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < states.size(); i++) scores[i] = evaluate(states[i]);
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Compare(const std::vector<State> &states, const int * scores, const int * expected, const char * name, const Player &positive, EvaluationResult &result)
+{
+    for(size_t i = 0; i < states.size(); i++) {
+        if(scores[i] == expected[i]) continue;
+        if(!result.mismatches++)
+            std::cerr << "Evaluation mismatch (" << name << ", positive " << positive << "): "
+                      << scores[i] << " instead of " << expected[i] << std::endl << states[i];
+    }
+}
+
+/// Evaluates all children of every node at depth <depth> - 1 with every evaluator, and compares the results.
+static void EvaluateLeaves(const State &state, int depth, EvaluationResult &result)
+{
+    static const C4BatchEvaluator::Kernel kernels[] = { C4BatchEvaluator::Kernel::Scalar, C4BatchEvaluator::Kernel::AVX2 };
+
+    std::vector<State> children = C4AI::GetChildStates(state);
+    if(depth > 1) {
+        for(const State &child : children) EvaluateLeaves(child, depth - 1, result);
+        return;
+    }
+    if(children.empty()) return;
+
+    BitBoard boards[MAX_BATCH];
+    for(size_t i = 0; i < children.size(); i++) boards[i] = toBitBoard(children[i]);
+
+    for(Player positive : { Player::X, Player::O }) {
+        int expected[MAX_BATCH];
+        bool expectedFinished[MAX_BATCH];
+        int scores[MAX_BATCH];
+        Time(children, expected, result.seconds[0], [&](const State &s) { return ReferenceEvaluation(s, positive); });
+        for(size_t i = 0; i < children.size(); i++) expectedFinished[i] = getMoves(children[i]).empty();
+
+        Time(children, scores, result.seconds[1], [&](const State &s) { return C4AI::EvaluateState(s, positive); });
+        Compare(children, scores, expected, EvaluatorNames[1], positive, result);
+
+        int expectedWindows[MAX_BATCH];
+        Time(children, expectedWindows, result.seconds[4], [&](const State &s) { return C4AI::RateByPotentialFours(s, positive); });
+        Time(children, scores, result.seconds[5], [&](const State &s) { return C4PatternEvaluator::RateWindows(s, positive); });
+        Compare(children, scores, expectedWindows, EvaluatorNames[5], positive, result);
+
+        for(int k = 0; k < 2; k++) {
+            bool finished[MAX_BATCH];
+            auto start = std::chrono::steady_clock::now();
+            C4BatchEvaluator::Evaluate(kernels[k], boards, (int) children.size(), positive, scores, finished);
+            result.seconds[k + 2] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for(size_t i = 0; i < children.size(); i++) {
+                if(scores[i] == expected[i] && finished[i] == expectedFinished[i]) continue;
+                if(!result.mismatches++)
+                    std::cerr << "Evaluation mismatch (" << C4BatchEvaluator::Name(kernels[k]) << ", positive " << positive << "): "
+                              << scores[i] << " instead of " << expected[i] << std::endl << children[i];
+            }
+        }
+
+        // Children passed in another order than they were generated in are still scored in the order they were passed
+        std::vector<State> reversed(children.rbegin(), children.rend());
+        bool finished[MAX_BATCH];
+        C4AI::EvaluateChildStates(state, reversed.data(), (int) reversed.size(), positive, scores, finished);
+        std::reverse(scores, scores + children.size());
+        Compare(children, scores, expected, "reversed children", positive, result);
+    }
+    result.leaves += children.size();
+}
+
+int main(int argc, char * argv[])
+{
+    int depth = 8;
+    int threads = 1;
+    bool evaluation = false;
+    std::vector<std::string> positions;
+
+    for(int i = 1; i < argc; i++) {
+        if(!std::strcmp(argv[i], "-d") && i + 1 < argc) depth = std::stoi(argv[++i]);
+        else if(!std::strcmp(argv[i], "-t") && i + 1 < argc) threads = std::stoi(argv[++i]);
+        else if(!std::strcmp(argv[i], "-e")) evaluation = true;
+        else positions.push_back(argv[i]);
+    }
+    if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if(positions.empty()) positions = { "-", "3", "3342", "33443322", "3332224405" };
+
+    bool allMatch = true;
+    for(const std::string &moves : positions) {
+        State root;
+        if(!parsePosition(moves, root)) {
+            std::cerr << "Invalid position: " << moves << std::endl;
+            return 2;
+        }
+        if(evaluation) {
+            std::cout << "Position \"" << moves << "\", evaluation at depth " << depth << ":" << std::endl << root;
+            EvaluationResult result;
+            if(depth > 0) EvaluateLeaves(root, depth, result);
+            allMatch = allMatch && !result.mismatches;
+
+            for(int e = 0; e < 6; e++)
+                std::cout << "  " << EvaluatorNames[e] << ": " << result.leaves * 2 << " evaluations in " << (long long) (result.seconds[e] * 1000) << " ms ("
+                          << (long long) (result.seconds[e] > 0 ? result.leaves * 2 / result.seconds[e] : 0) << " evaluations/s)" << std::endl;
+            std::cout << "  " << result.mismatches << " mismatches, best kernel on this CPU: " << C4BatchEvaluator::Name(C4BatchEvaluator::Best()) << std::endl;
+            continue;
+        }
+
+        std::cout << "Position \"" << moves << "\", depth " << depth << ", " << threads << " thread(s):" << std::endl << root;
+
+        PerftResult reference;
+        for(const Implementation &impl : implementations) {
+            auto start = std::chrono::steady_clock::now();
+            PerftResult result = RunSplit(impl, root, depth, threads);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if(&impl == implementations) reference = result;
+            bool match = result == reference;
+            allMatch = allMatch && match;
+
+            std::cout << "  " << impl.name << ": " << result << " in " << (long long) (seconds * 1000) << " ms ("
+                      << (long long) (seconds > 0 ? result.leaves / seconds : 0) << " positions/s)"
+                      << (match ? "" : " MISMATCH") << std::endl;
+        }
+    }
+
+    if(!allMatch) std::cerr << "ERROR: Implementations do not match the reference!" << std::endl;
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/// c4replay: streams game records (see C4GameRecord.h) and prints a summary of every match.
+///
+/// Usage: c4replay [-p] file ...
+/// - -p: also print every position of every match
+/// - file: file containing records, "-" reads from stdin
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "C4GameRecord.h"
+
+static bool Replay(std::istream &in, const std::string &name, bool printPositions, int &matches)
+{
+    GameRecordReader reader(in);
+    GameRecord record;
+    while(reader.next(record)) {
+        matches++;
+
+        // Positions are rebuilt move by move while scanning, nothing but the moves is stored
+        State state = { { { { Player::None } } } };
+        std::cout << "#" << matches << ": " << record.player_names[0] << " vs " << record.player_names[1]
+                  << " (playing as " << record.your_bot << ", id " << record.your_botid << ", "
+                  << record.time_per_move << " ms per move, " << record.timebank << " ms time-bank left)" << std::endl << "  moves: ";
+        for(Move m : record.moves) {
+            std::cout << m;
+            if(printPositions) std::cout << std::endl << (state = doMove(state, m));
+            else state = doMove(state, m);
+        }
+
+        Player winner = getWinner(state);
+        if(winner != Player::None) std::cout << std::endl << "  won by " << winner << std::endl;
+        else if(getMoves(state).empty()) std::cout << std::endl << "  draw" << std::endl;
+        else std::cout << std::endl << "  unfinished" << std::endl;
+    }
+
+    if(reader.corrupt()) {
+        std::cerr << "ERROR: " << name << " is corrupt after " << matches << " record(s)." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    bool printPositions = false;
+    bool ok = true;
+    int matches = 0;
+
+    for(int i = 1; i < argc; i++) {
+        if(!std::strcmp(argv[i], "-p")) printPositions = true;
+        else if(!std::strcmp(argv[i], "-")) ok = Replay(std::cin, "stdin", printPositions, matches) && ok;
+        else {
+            std::ifstream file(argv[i], std::ios::binary);
+            if(!file) {
+                std::cerr << "ERROR: Could not open " << argv[i] << std::endl;
+                ok = false;
+                continue;
+            }
+            ok = Replay(file, argv[i], printPositions, matches) && ok;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include "C4Server.h"
+
+#include <exception>
+#include <iostream>
+
+C4Server::C4Server(unsigned threads, size_t tableMegabytes, const Selectivity &selectivity, GameRecordWriter * recorder)
+        : table(tableMegabytes), pool(threads), selectivity(selectivity), recorder(recorder) {}
+
+void C4Server::run()
+{
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        Command command;
+        command.received = std::chrono::steady_clock::now();
+        command.words = C4Bot::split(line, ' ');
+        if (command.words.size() < 2) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cerr << "Unknown command: " << line << std::endl;
+            continue;
+        }
+        std::string id = command.words[0];
+        command.words.erase(command.words.begin());
+        enqueue(id, std::move(command));
+    }
+
+    // Input has been closed, let all matches finish what they've been asked to do
+    std::unique_lock<std::mutex> lock(idleMutex);
+    idle.wait(lock, [this]() { return busySessions == 0; });
+
+    for (auto &session : sessions) session.second->bot.finish();
+}
+
+void C4Server::enqueue(const std::string &id, Command command)
+{
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        std::shared_ptr<Session> &entry = sessions[id];
+        if (!entry) {
+            entry = std::make_shared<Session>();
+            SearchResources resources;
+            resources.table = &table;
+            resources.pool = &pool;
+            resources.log = &entry->log;
+            resources.selectivity = selectivity;
+            entry->bot = C4Bot(resources);
+            entry->bot.setRecorder(recorder);
+        }
+        session = entry;
+    }
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    session->pending.push_back(std::move(command));
+    if (session->scheduled) return;
+
+    session->scheduled = true;
+    {
+        std::lock_guard<std::mutex> idleLock(idleMutex);
+        busySessions++;
+    }
+    pool.submit([this, id, session]() { drain(id, session); });
+}
+
+void C4Server::drain(const std::string &id, std::shared_ptr<Session> session)
+{
+    while (true) {
+        Command command;
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            if (session->pending.empty()) {
+                session->scheduled = false;
+                break;
+            }
+            command = std::move(session->pending.front());
+            session->pending.pop_front();
+        }
+
+        if (command.words[0] == "end") {
+            session->bot.finish();
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            auto it = sessions.find(id);
+            if (it != sessions.end() && it->second == session) sessions.erase(it);
+            continue;
+        }
+
+        // A malformed command is dropped, it must not take the other matches on this server down with it
+        std::ostringstream reply;
+        try {
+            session->bot.handle(command.words, reply, command.received);
+        } catch (const std::exception &e) {
+            session->log << "Dropped invalid command:";
+            for (const std::string &word : command.words) session->log << " " << word;
+            session->log << " (" << e.what() << ")" << std::endl;
+            reply.str("");
+        }
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::string logged = session->log.str();
+        session->log.str("");
+        if (!logged.empty()) {
+            std::istringstream lines(logged);
+            std::string logLine;
+            while (std::getline(lines, logLine)) std::cerr << "[" << id << "] " << logLine << "\n";
+            std::cerr.flush();
+        }
+        if (!reply.str().empty()) std::cout << id << " " << reply.str() << std::flush;
+    }
+
+    std::lock_guard<std::mutex> lock(idleMutex);
+    if (--busySessions == 0) idle.notify_all();
+}
@@ -0,0 +1,64 @@
+#ifndef C4SERVER_H
+#define C4SERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "C4Bot.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
+
+/// Plays any amount of concurrent matches in a single process.
+/// Every line of input is a regular C4Bot command prefixed with the ID of the match it belongs to, ie:
+///   <match-id> settings time_per_move 500
+///   <match-id> update game field 0,.,.,...
+///   <match-id> action move 10000
+///   <match-id> end                         (optional, records and forgets the match)
+/// Replies are prefixed the same way: "<match-id> place_disc 3".
+/// Commands of a match are handled in order; matches run concurrently on a shared thread pool
+/// and share a single transposition table. Every match keeps its own clock.
+class C4Server {
+public:
+    /// Matches are appended to 'recorder' when it is set (see C4GameRecord.h)
+    C4Server(unsigned threads, size_t tableMegabytes, const Selectivity &selectivity = Selectivity(), GameRecordWriter * recorder = nullptr);
+
+    /// Reads commands from std::cin until it is closed, returns once all matches have finished their last command.
+    void run();
+
+private:
+    struct Command {
+        std::vector<std::string> words;
+        std::chrono::time_point<std::chrono::steady_clock> received;
+    };
+
+    struct Session {
+        std::mutex mutex;
+        std::deque<Command> pending;    // Commands waiting to be handled
+        bool scheduled = false;         // Whether a job to handle pending commands has been submitted to the pool
+        std::ostringstream log;         // Log of the command being handled, only used by the job
+        C4Bot bot;
+    };
+
+    TranspositionTable table;
+    ThreadPool pool;
+    Selectivity selectivity;
+    GameRecordWriter * recorder;
+
+    std::mutex sessionsMutex;
+    std::map<std::string, std::shared_ptr<Session>> sessions;
+
+    std::mutex outputMutex;             // Guards std::cout and std::cerr
+
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    int busySessions = 0;
+
+    void enqueue(const std::string &id, Command command);
+    void drain(const std::string &id, std::shared_ptr<Session> session);
+};
+
+#endif
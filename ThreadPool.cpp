@@ -0,0 +1,145 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    thread_local const ThreadPool * currentPool = nullptr;
+    thread_local int currentIndex = -1;
+}
+
+ThreadPool::ThreadPool(unsigned threads) : pending(0), stopping(false)
+{
+    if(threads == 0) threads = 1;
+    for(unsigned i = 0; i < threads; i++) queues.emplace_back(new Queue());
+    for(unsigned i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread &w : workers) w.join();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs.mutex);
+        jobs.tasks.push_back(Task { std::move(job), nullptr });
+    }
+    notify();
+}
+
+void ThreadPool::spawn(Group &group, std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(group.mutex);
+        group.remaining++;
+    }
+
+    int self = currentWorker();
+    Queue &queue = self < 0 ? jobs : *queues[self];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task { std::move(task), &group });
+    }
+    notify();
+}
+
+void ThreadPool::wait(Group &group)
+{
+    int self = currentWorker();
+    while(runTask(self, &group));
+
+    // Whatever is left is being run by other threads
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.finished.wait(lock, [&group]() { return group.remaining == 0; });
+}
+
+void ThreadPool::work(unsigned self)
+{
+    currentPool = this;
+    currentIndex = self;
+
+    while(true) {
+        if(runTask(self) || runJob()) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return pending > 0 || stopping; });
+        if(stopping && pending == 0) return;
+    }
+}
+
+bool ThreadPool::runTask(int self, Group * group)
+{
+    Task task;
+
+    // Own tasks first, newest first
+    bool found = self >= 0 && take(*queues[self], group, true, task);
+
+    // Steal the oldest task of another worker
+    for(size_t i = 1; !found && i <= queues.size(); i++)
+        found = take(*queues[(self + i) % queues.size()], group, false, task);
+
+    // Tasks spawned from outside the pool wait among the jobs
+    if(!found && group) found = take(jobs, group, false, task);
+
+    if(!found) return false;
+    run(task);
+    return true;
+}
+
+bool ThreadPool::runJob()
+{
+    Task job;
+    if(!take(jobs, nullptr, false, job)) return false;
+    run(job);
+    return true;
+}
+
+void ThreadPool::run(Task &task)
+{
+    pending--;
+    task.run();
+    if(!task.group) return;
+
+    Group &group = *task.group;
+    std::lock_guard<std::mutex> lock(group.mutex);
+    if(--group.remaining == 0) group.finished.notify_all();
+}
+
+bool ThreadPool::take(Queue &queue, Group * group, bool newest, Task &task)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    auto matches = [group](const Task &t) { return !group || t.group == group; };
+    if(newest) {
+        auto it = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), matches);
+        if(it == queue.tasks.rend()) return false;
+        task = std::move(*it);
+        queue.tasks.erase(std::next(it).base());
+    } else {
+        auto it = std::find_if(queue.tasks.begin(), queue.tasks.end(), matches);
+        if(it == queue.tasks.end()) return false;
+        task = std::move(*it);
+        queue.tasks.erase(it);
+    }
+    return true;
+}
+
+void ThreadPool::notify()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pending++;
+    }
+    wake.notify_one();
+}
+
+int ThreadPool::currentWorker() const
+{
+    return currentPool == this ? currentIndex : -1;
+}
@@ -0,0 +1,89 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Work-stealing thread pool.
+/// Every worker owns a deque of tasks; it pops its own tasks from the back (newest first)
+/// and steals from the front of other workers' deques (oldest first) when it runs out.
+/// Top-level jobs (ie. an entire turn of a match) are submitted to a shared FIFO queue instead,
+/// which is only served by idle workers. Tasks belong to a group, a thread that waits for a group (see 'wait')
+/// only helps with tasks of that group, so it never gets stuck in the work of another job.
+class ThreadPool {
+public:
+    /// Tasks that are waited for together
+    class Group {
+    public:
+        Group() = default;
+        Group(const Group &) = delete;
+        Group & operator=(const Group &) = delete;
+
+    private:
+        friend class ThreadPool;
+        std::mutex mutex;
+        std::condition_variable finished;
+        int remaining = 0;                      // Tasks spawned but not finished yet, guarded by 'mutex'
+    };
+
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    /// Queues a top-level job, it is picked up by the first idle worker.
+    void submit(std::function<void()> job);
+
+    /// Queues a task of <group> that may be stolen by other workers, called from within a job or task.
+    /// When called from a thread that is not part of this pool it is queued like a job.
+    void spawn(Group &group, std::function<void()> task);
+
+    /// Returns once all tasks spawned in <group> have finished. Meanwhile the calling thread runs tasks of <group>
+    /// (its own first, then stolen ones); when other threads are running all that's left it sleeps.
+    void wait(Group &group);
+
+    unsigned size() const { return (unsigned) workers.size(); }
+
+private:
+    struct Task {
+        std::function<void()> run;
+        Group * group;                          // nullptr for jobs
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;   // One per worker
+    Queue jobs;                                 // Top-level jobs, shared by all workers
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> pending;                   // Amount of queued jobs and tasks
+    std::atomic<bool> stopping;
+
+    void work(unsigned self);
+
+    /// Runs a task of <group>, or of any group when nullptr. Returns false if there was none.
+    bool runTask(int self, Group * group = nullptr);
+    bool runJob();
+    void run(Task &task);
+    void notify();
+
+    /// Removes a task of <group> (any task when nullptr) from <queue>, the newest or the oldest one.
+    static bool take(Queue &queue, Group * group, bool newest, Task &task);
+
+    /// Index of the worker the calling thread belongs to, or -1 when it isn't part of this pool.
+    int currentWorker() const;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "TranspositionTable.h"
+
+#include <new>
+
+TranspositionTable::TranspositionTable(size_t megabytes, bool hugePages)
+        : slotCount(SlotCount(megabytes)), memory(slotCount * sizeof(Slot), hugePages)
+{
+    slots = static_cast<Slot *>(memory.data());
+    for(size_t i = 0; i < slotCount; i++) new (&slots[i]) Slot();
+    clear();
+}
+
+size_t TranspositionTable::SlotCount(size_t megabytes)
+{
+    // Round down to a power of 2 so slots can be indexed by masking
+    size_t wanted = (megabytes << 20) / sizeof(Slot);
+    size_t count = 1;
+    while(count * 2 <= wanted) count *= 2;
+    return count;
+}
+
+bool TranspositionTable::probe(uint64_t key, Entry &entry) const
+{
+    const Slot &slot = slots[index(key)];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.check.load(std::memory_order_relaxed);
+    if(data == 0 || (check ^ data) != key) return false;
+
+    entry = unpack(data);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, const Entry &entry)
+{
+    Slot &slot = slots[index(key)];
+    uint64_t old = slot.data.load(std::memory_order_relaxed);
+    if(old && (slot.check.load(std::memory_order_relaxed) ^ old) == key) {
+        Entry existing = unpack(old);
+        if(existing.depth > entry.depth && !entry.complete) return;
+    }
+
+    uint64_t data = pack(entry);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear()
+{
+    for(size_t i = 0; i < slotCount; i++) {
+        slots[i].check.store(0, std::memory_order_relaxed);
+        slots[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t TranspositionTable::index(uint64_t key) const
+{
+    // Keys tend to differ in a few bits only, spread them over the table (Fibonacci hashing)
+    return (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (slotCount - 1);
+}
+
+/// Data layout: value (32 bits) | depth (8 bits) | bound (2 bits) | complete (1 bit) | valid (1 bit) | best child + 1 (3 bits)
+/// The valid bit guarantees occupied slots never hold 0, which marks an empty slot.
+uint64_t TranspositionTable::pack(const Entry &entry)
+{
+    uint64_t bestChild = entry.bestChild >= 0 && entry.bestChild < 7 ? entry.bestChild + 1 : 0;
+    return (uint64_t) (uint32_t) entry.value
+           | (uint64_t) (entry.depth & 0xFF) << 32
+           | (uint64_t) entry.bound << 40
+           | (uint64_t) entry.complete << 42
+           | 1ULL << 43
+           | bestChild << 44;
+}
+
+TranspositionTable::Entry TranspositionTable::unpack(uint64_t data)
+{
+    Entry entry;
+    entry.value = (int) (uint32_t) data;
+    entry.depth = (int) (data >> 32 & 0xFF);
+    entry.bound = (Bound) (data >> 40 & 0x3);
+    entry.complete = (data >> 42 & 0x1) != 0;
+    entry.bestChild = (int) (data >> 44 & 0x7) - 1;
+    return entry;
+}
@@ -0,0 +1,66 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "AlignedBuffer.h"
+
+/// Fixed-size hash table of search results, safe to share between any amount of threads without locking.
+/// Every slot holds a key and a data word, the key is stored xor'ed with the data;
+/// a slot that was torn by concurrent writes will fail the key check and is treated as empty.
+class TranspositionTable {
+public:
+    enum class Bound : uint8_t {
+        Exact,  // Value is the exact value of the node
+        Lower,  // Value is a lower bound, the search failed high
+        Upper   // Value is an upper bound, the search failed low
+    };
+
+    struct Entry {
+        int value = 0;
+        int depth = 0;              // Remaining search depth the value was found with
+        Bound bound = Bound::Exact;
+        bool complete = false;      // The subtree was exhausted, value doesn't depend on depth
+        int bestChild = -1;         // Index of the best child (0-6) if known, searched first next time
+    };
+
+    /// Tables of at least 2 MB are backed by huge pages where possible, unless 'hugePages' is false.
+    explicit TranspositionTable(size_t megabytes, bool hugePages = true);
+
+    /// Looks up passed key, returns false if it isn't present.
+    bool probe(uint64_t key, Entry &entry) const;
+
+    /// Stores an entry, replacing whatever occupied its slot unless that is a deeper search of the same key.
+    void store(uint64_t key, const Entry &entry);
+
+    void clear();
+
+    size_t size() const { return slotCount; }
+
+    /// Memory used by the table in bytes
+    size_t bytes() const { return memory.size(); }
+
+    bool hugePages() const { return memory.hugePages(); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check;    // key ^ data
+        std::atomic<uint64_t> data;
+    };
+
+    size_t slotCount;
+    AlignedBuffer memory;
+    Slot * slots;
+
+    size_t index(uint64_t key) const;
+
+    /// Largest power of 2 of slots that fits in passed size
+    static size_t SlotCount(size_t megabytes);
+
+    static uint64_t pack(const Entry &entry);
+    static Entry unpack(uint64_t data);
+};
+
+#endif
@@ -1,8 +1,120 @@
 #ifndef TREESEARCH_H
 #define TREESEARCH_H
 
+#include <algorithm>
+#include <chrono>
+#include <new>
 #include <vector>
 
+#include "AlignedBuffer.h"
+#include "C4Game.h"
+#include "TranspositionTable.h"
+
+/// Most children of a node that are evaluated in batch or kept in a SearchStack frame, enough for every connect4 node.
+/// Nodes with more children are never evaluated in batch.
+const static int MAX_BATCH = 8;
+
+/// Selective depth control of MiniMaxAB; setting 'reduction' and 'maxExtensions' to 0 searches every child to exactly depth-1.
+struct Selectivity {
+    int reduction = 1;          // Depth by which late moves are reduced
+    int lateMoveIndex = 3;      // Children from this index on (in order of 'findChildNodes') are late moves
+    int reductionMinDepth = 3;  // Late moves are only reduced when at least this much depth is left
+    int maxExtensions = 1;      // Maximum amount of forcing moves extended by 1 along a single line
+};
+
+/// Preallocated storage for the children MiniMaxAB generates, one cache line aligned frame per ply.
+/// A search using a stack doesn't allocate any memory, its footprint is fixed when the stack is created.
+/// A stack can only be used by one search at a time, ie. one stack per thread. A stack without frames makes searches allocate as usual.
+/// Frames are released when their node returns, also when the search was aborted, so a stack is empty again once its search returns.
+template <class O>
+class SearchStack {
+public:
+    struct alignas(AlignedBuffer::CACHE_LINE) Frame {
+        O children[MAX_BATCH];
+        int count;                  // Amount of children
+        int values[MAX_BATCH];      // Values of children evaluated in batch
+        bool finished[MAX_BATCH];   // Whether children evaluated in batch have no children of their own
+    };
+
+    explicit SearchStack(int plies = 64) : memory(plies * sizeof(Frame)), frames(static_cast<Frame *>(memory.data())), capacity(plies)
+    {
+        for(int i = 0; i < capacity; i++) new (&frames[i]) Frame();
+    }
+
+    ~SearchStack()
+    {
+        for(int i = 0; i < capacity; i++) frames[i].~Frame();
+    }
+
+    SearchStack(const SearchStack &) = delete;
+    SearchStack & operator=(const SearchStack &) = delete;
+
+    /// Frame of the next ply, or nullptr when all frames are in use
+    Frame * push() { return top < capacity ? &frames[top++] : nullptr; }
+    void pop() { top--; }
+
+    /// Amount of frames in use, 0 when no search is using the stack
+    int depth() const { return top; }
+
+    size_t bytes() const { return memory.size(); }
+
+private:
+    AlignedBuffer memory;
+    Frame * frames;
+    int capacity;
+    int top = 0;
+};
+
+/// Optional state shared by all nodes of a single search.
+template <class O>
+struct SearchContext {
+    TranspositionTable * table = nullptr;                   // Results are stored in and looked up from this table, if set
+    uint64_t (*hash)(const O &, const Player &) = nullptr;  // Unique key of a node from the perspective of a player, required when using a table
+
+    bool hasDeadline = false;                               // Abort the search once 'deadline' has passed?
+    std::chrono::steady_clock::time_point deadline;
+    bool aborted = false;                                   // Set when the deadline has passed, the searches' result is meaningless when set
+
+    /// When both are set children are generated into the frames of 'stack' instead of being returned by 'findChildNodes'.
+    /// 'fillChildNodes' writes the same children 'findChildNodes' would return (at most MAX_BATCH) and returns their amount.
+    SearchStack<O> * stack = nullptr;
+    int (*fillChildNodes)(const O &, O *) = nullptr;
+
+    /// Evaluates all children of a node at once, when set it replaces 'evaluate' for children at the depth limit.
+    /// Arguments: parent, children, amount of children, positive player, values (out), whether each child has no children of its own (out).
+    /// Values are written in the order of the passed children, whatever order they were generated in.
+    void (*evaluateChildren)(const O &, const O *, int, const Player &, int *, bool *) = nullptr;
+
+    Selectivity selectivity;
+    /// Marks which children of a node force a reply when moved to, forcing moves are extended and never reduced.
+    /// Arguments: parent, children, amount of children, whether each child is forcing (out).
+    /// Asked once per node, only for nodes with at most MAX_BATCH children of which some may be extended or reduced.
+    void (*findForcing)(const O &, const O *, int, bool *) = nullptr;
+    int extensionsUsed = 0;                                 // Extensions along the line currently being searched
+
+    unsigned long long nodes = 0;                           // Amount of nodes visited
+    unsigned long long reductions = 0;                      // Amount of late moves searched with reduced depth
+    unsigned long long researches = 0;                      // Amount of reduced searches that had to be repeated at full depth
+    unsigned long long extensions = 0;                      // Amount of forcing moves searched with extended depth
+
+    /// Counts a visited node, returns true if the search has to be aborted.
+    /// Checking the clock is relatively expensive, it is only done every 1024 nodes.
+    bool visit()
+    {
+        if(!(++nodes & 1023) && hasDeadline && std::chrono::steady_clock::now() > deadline) aborted = true;
+        return aborted;
+    }
+
+    /// Adds the statistics of another context to this one
+    void addStatistics(const SearchContext &other)
+    {
+        nodes += other.nodes;
+        reductions += other.reductions;
+        researches += other.researches;
+        extensions += other.extensions;
+    }
+};
+
 class TreeSearch {
 public:
     template <class O>
@@ -11,11 +123,14 @@ public:
     /// https://en.wikipedia.org/wiki/Minimax#Minimax_algorithm_with_alternate_moves
     /// https://en.wikipedia.org/wiki/Alpha%E2%80%93beta_pruning
     /// Function arguments alpha and beta should be the worst and best value possible of type V, respectively.
-    static int MiniMaxAB(O branch, int (*evaluate)(const O &, const Player &), std::vector<O> (*findChildNodes)(const O &), int depth, bool maximize, Player p, int worstVal, int bestVal, bool * isFullTreeEvaluated);
+    static int MiniMaxAB(const O & branch, int (*evaluate)(const O &, const Player &), std::vector<O> (*findChildNodes)(const O &), int depth, bool maximize, Player p, int worstVal, int bestVal, bool * isFullTreeEvaluated, SearchContext<O> * context = nullptr);
 
-};
+    template <class O>
+    /// Follows the best children stored in the contexts' transposition table, starting at <branch>.
+    /// Returns the nodes of the line both players are expected to play (excluding <branch>), at most <maxLength> of them.
+    static std::vector<O> PrincipalVariation(O branch, std::vector<O> (*findChildNodes)(const O &), Player p, const SearchContext<O> & context, int maxLength);
 
-#endif
+};
 
 /// TreeSearch.tpp
 
@@ -29,14 +144,56 @@ public:
 /// - bool maximize: Whether or not to maximize the player who is on move in root node 'branch'
 /// - int worstVal: the worst score possible; usually gained when losing the game (used for recursion, int min recommended)
 /// - int bestVal: the best score possible; usually gained when winning the game (used for recursion, int max recommended)
+/// - SearchContext<Node> * context: Optional transposition table, deadline and selectivity, may be shared by concurrent searches as long as each has its own context
+/// Late moves that beat the current best value of a node after a reduced search are searched again at full depth.
+/// The best child found by an earlier search of a node (if stored in the table) is searched first, at any depth.
 template<class O>
-int TreeSearch::MiniMaxAB(O branch, int (*evaluate)(const O &, const Player &), std::vector<O> (*findChildNodes)(const O &), int depth, bool maximize, Player p, int worstVal, int bestVal, bool * isFullTreeEvaluated)
+int TreeSearch::MiniMaxAB(const O & branch, int (*evaluate)(const O &, const Player &), std::vector<O> (*findChildNodes)(const O &), int depth, bool maximize, Player p, int worstVal, int bestVal, bool * isFullTreeEvaluated, SearchContext<O> * context)
 {
-    // Get all child nodes with function passed as argument
-    auto children = findChildNodes(branch);
+    if(context && (context->aborted || context->visit())) return worstVal;
+
+    // Look for results of earlier searches of this node, only exhausted subtrees can be used regardless of depth
+    bool useTable = depth && context && context->table;
+    uint64_t key = 0;
+    int hint = -1;
+    if(useTable) {
+        key = context->hash(branch, p);
+        TranspositionTable::Entry entry;
+        bool found = context->table->probe(key, entry);
+        if(found) hint = entry.bestChild;
+        if(found && (entry.depth >= depth || entry.complete)) {
+            bool usable = entry.bound == TranspositionTable::Bound::Exact
+                          || (entry.bound == TranspositionTable::Bound::Lower && entry.value >= bestVal)
+                          || (entry.bound == TranspositionTable::Bound::Upper && entry.value <= worstVal);
+            if(usable) {
+                if(!entry.complete) *isFullTreeEvaluated = false;
+                return entry.value;
+            }
+        }
+    }
+
+    // Get all child nodes, in the frame of this ply if the search has a stack, with function passed as argument otherwise
+    typename SearchStack<O>::Frame * frame = context && context->stack && context->fillChildNodes ? context->stack->push() : nullptr;
+    struct FrameGuard {
+        SearchStack<O> * stack;
+        ~FrameGuard() { if(stack) stack->pop(); }
+    } guard = { frame ? context->stack : nullptr };
+
+    std::vector<O> allocated;
+    const O * children;
+    size_t childCount;
+    if(frame) {
+        frame->count = context->fillChildNodes(branch, frame->children);
+        children = frame->children;
+        childCount = (size_t) frame->count;
+    } else {
+        allocated = findChildNodes(branch);
+        children = allocated.data();
+        childCount = allocated.size();
+    }
 
     // This branch has no children, all we can do is evaluate it now
-    if(children.empty()) return evaluate(branch, p);
+    if(!childCount) return evaluate(branch, p);
 
     // Depth limit has been reached, return value of current node
     if(!depth) {
@@ -44,25 +201,118 @@ int TreeSearch::MiniMaxAB(O branch, int (*evaluate)(const O &, const Player &),
         return evaluate(branch, p);
     }
 
-    int value;
-    if(maximize) {
-        value = worstVal;
-        for(O child:children) {
-            int childVal = MiniMaxAB(child, evaluate, findChildNodes, depth-1, false, p, worstVal, bestVal, isFullTreeEvaluated);
-            if(childVal > value) value = childVal;
-            if(value > worstVal) worstVal = value;
-            if(worstVal >= bestVal) break;
+    int alpha = worstVal;
+    int beta = bestVal;
+    bool isSubtreeEvaluated = true;
+
+    // All children that won't be searched any deeper can be evaluated together
+    int localValues[MAX_BATCH];
+    bool localFinished[MAX_BATCH];
+    int * batchValues = frame ? frame->values : localValues;
+    bool * batchFinished = frame ? frame->finished : localFinished;
+    bool batched = depth == 1 && context && context->evaluateChildren && childCount <= MAX_BATCH;
+    if(batched) context->evaluateChildren(branch, children, (int) childCount, p, batchValues, batchFinished);
+
+    // Extensions along this line are restored after every child, so whether children may be extended holds for all of them
+    bool mayExtend = false;
+    bool anyForcing = false;
+    bool forcing[MAX_BATCH];
+    if(context) {
+        const Selectivity &sel = context->selectivity;
+        mayExtend = context->extensionsUsed < sel.maxExtensions;
+        bool mayReduce = sel.reduction > 0 && childCount > (size_t) sel.lateMoveIndex && depth >= sel.reductionMinDepth;
+        anyForcing = (mayExtend || mayReduce) && context->findForcing && childCount <= MAX_BATCH;
+        if(anyForcing) context->findForcing(branch, children, (int) childCount, forcing);
+    }
+
+    // Search the hinted child first, followed by all others in their original order
+    size_t first = hint >= 0 && (size_t) hint < childCount ? (size_t) hint : 0;
+
+    int value = maximize ? worstVal : bestVal;
+    int bestChild = -1;
+    for(size_t k = 0; k < childCount; k++) {
+        size_t i = k == 0 ? first : (k <= first ? k - 1 : k);
+        const O &child = children[i];
+        int childDepth = depth - 1;
+        bool reduced = false;
+        int extension = 0;
+
+        if(context) {
+            const Selectivity &sel = context->selectivity;
+            bool mayReduce = sel.reduction > 0 && k >= (size_t) sel.lateMoveIndex && depth >= sel.reductionMinDepth;
+            bool isForcing = anyForcing && forcing[i];
+            if(isForcing && mayExtend) {
+                extension = 1;
+                context->extensions++;
+            } else if(!isForcing && mayReduce) {
+                reduced = true;
+                childDepth = std::max(0, childDepth - sel.reduction);
+                context->reductions++;
+            }
+            childDepth += extension;
+            context->extensionsUsed += extension;
         }
-    } else {
-        value = bestVal;
-        for(O child:children) {
-            int childVal = MiniMaxAB(child, evaluate, findChildNodes, depth-1, true, p, worstVal, bestVal, isFullTreeEvaluated);
-            if(childVal < value) value = childVal;
+
+        bool isChildEvaluated = true;
+        int childVal;
+        if(batched && childDepth == 0) {
+            // Equivalent to searching the child with depth 0
+            context->visit();
+            childVal = batchValues[i];
+            if(!batchFinished[i]) isChildEvaluated = false;
+        }
+        else childVal = MiniMaxAB(child, evaluate, findChildNodes, childDepth, !maximize, p, worstVal, bestVal, &isChildEvaluated, context);
+
+        if(reduced && childDepth < depth - 1 && (maximize ? childVal > worstVal : childVal < bestVal)) {
+            // Late move might be better than expected, verify with a full depth search
+            context->researches++;
+            isChildEvaluated = true;
+            childVal = MiniMaxAB(child, evaluate, findChildNodes, depth-1, !maximize, p, worstVal, bestVal, &isChildEvaluated, context);
+        }
+        if(context) context->extensionsUsed -= extension;
+        if(!isChildEvaluated) isSubtreeEvaluated = false;
+
+        if(maximize) {
+            if(childVal > value) { value = childVal; bestChild = (int) i; }
+            if(value > worstVal) worstVal = value;
+        } else {
+            if(childVal < value) { value = childVal; bestChild = (int) i; }
             if(value < bestVal) bestVal = value;
-            if(worstVal >= bestVal) break;
         }
+        if(worstVal >= bestVal) break;
+    }
+
+    if(!isSubtreeEvaluated) *isFullTreeEvaluated = false;
+
+    if(useTable && !context->aborted) {
+        TranspositionTable::Entry entry;
+        entry.value = value;
+        entry.depth = depth;
+        entry.complete = isSubtreeEvaluated;
+        entry.bestChild = bestChild;
+        if(value <= alpha) entry.bound = TranspositionTable::Bound::Upper;
+        else if(value >= beta) entry.bound = TranspositionTable::Bound::Lower;
+        else entry.bound = TranspositionTable::Bound::Exact;
+        context->table->store(key, entry);
     }
 
     return value;
 }
 
+template<class O>
+std::vector<O> TreeSearch::PrincipalVariation(O branch, std::vector<O> (*findChildNodes)(const O &), Player p, const SearchContext<O> & context, int maxLength)
+{
+    std::vector<O> line;
+    if(!context.table) return line;
+
+    TranspositionTable::Entry entry;
+    while((int) line.size() < maxLength && context.table->probe(context.hash(branch, p), entry) && entry.bestChild >= 0) {
+        auto children = findChildNodes(branch);
+        if((size_t) entry.bestChild >= children.size()) break;
+        branch = children[entry.bestChild];
+        line.push_back(branch);
+    }
+    return line;
+}
+
+#endif
@@ -1,10 +1,63 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
 #include "C4Bot.h"
 #include "C4Abstract.h"
+#include "C4GameRecord.h"
+#include "C4PatternEvaluator.h"
+#include "C4Server.h"
+#include "TranspositionTable.h"
 
-int main()
+/// Usage: c4test [--server [--threads n]] [--hash megabytes] [--reduction n] [--extensions n] [--record file] [--weights file]
+/// Without arguments a single match is played over stdin/stdout,
+/// with --server any amount of matches are multiplexed over stdin/stdout (see C4Server.h).
+/// --reduction and --extensions configure the selectivity of the search (see Selectivity in TreeSearch.h), 0 disables either.
+/// --record appends every match played to passed file (see C4GameRecord.h).
+/// --hash sets the size of the transposition table, which also carries search results over to the next turn.
+/// --weights replaces the heuristics' weights by those in passed file (see C4PatternEvaluator::Load).
+int main(int argc, char * argv[])
 {
-    C4Bot bot;
+    bool server = false;
+    unsigned threads = std::thread::hardware_concurrency();
+    size_t hashMegabytes = 64;
+    Selectivity selectivity;
+    std::unique_ptr<GameRecordWriter> recorder;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--server")) server = true;
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) threads = (unsigned) std::stoul(argv[++i]);
+        else if (!std::strcmp(argv[i], "--hash") && i + 1 < argc) hashMegabytes = std::stoul(argv[++i]);
+        else if (!std::strcmp(argv[i], "--reduction") && i + 1 < argc) selectivity.reduction = std::stoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--extensions") && i + 1 < argc) selectivity.maxExtensions = std::stoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--record") && i + 1 < argc) recorder.reset(new GameRecordWriter(argv[++i]));
+        else if (!std::strcmp(argv[i], "--weights") && i + 1 < argc) {
+            std::ifstream file(argv[++i]);
+            PatternWeights weights = C4PatternEvaluator::DefaultWeights();
+            if (!file || !C4PatternEvaluator::Load(file, weights)) {
+                std::cerr << "ERROR: Could not load weights from " << argv[i] << std::endl;
+                return 1;
+            }
+            C4PatternEvaluator::Use(weights);
+        }
+    }
+
+    if (server) {
+        C4Server c4server(threads, hashMegabytes, selectivity, recorder.get());
+        c4server.run();
+        return 0;
+    }
+
+    TranspositionTable table(hashMegabytes);
+    SearchResources resources;
+    resources.table = &table;
+    resources.selectivity = selectivity;
+    C4Bot bot(resources);
+    bot.setRecorder(recorder.get());
     bot.run();
 
     return 0;
-}
\ No newline at end of file
+}